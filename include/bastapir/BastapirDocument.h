@@ -16,9 +16,12 @@
 
 #pragma once
 
+#include <bastapir/BuildCache.h>
 #include <bastapir/tap/TapArchiveBuilder.h>
 #include <bastapir/bas/BasicTextParser.h>
 #include <bastapir/common/SourceFile.h>
+#include <bastapir/common/ThreadPool.h>
+#include <optional>
 
 namespace bastapir
 {
@@ -27,19 +30,91 @@ namespace bastapir
 		
 		BastapirDocument(ErrorLogging * log);
 		
+		/// Sets |pool| used for loading and compiling files referenced from the document.
+		/// Files are still added to the archive in document order and all messages are
+		/// reported in the same order as when the document is processed sequentially.
+		/// If pool is nullptr, then all files are processed on the calling thread.
+		void setThreadPool(ThreadPool * pool);
+		
+		/// Sets |cache| with compiled BASIC programs. Programs found in the cache are not
+		/// parsed again and newly compiled programs are stored to the cache. If cache is
+		/// nullptr, then all programs are always compiled.
+		void setBuildCache(const BuildCache * cache);
+		
+		/// Sets how files referenced from the document are loaded. The default `MapLargeFiles`
+		/// is the fastest, but the files must not be rewritten until the archive is written.
+		/// Long running processes, where files are edited between builds, should use `ReadIntoBuffer`.
+		void setFileLoading(SourceFile::Loading loading);
+		/// Returns how files referenced from the document are loaded.
+		SourceFile::Loading fileLoading() const;
+		
+		/// Parses document |file| and builds archive bytes in memory. The bytes are then
+		/// available in `archiveBytes()`.
 		bool processDocument(const SourceTextFile & file);
+		/// Parses document |file| and validates all files for the archive, but doesn't build
+		/// the archive. Use `writeArchive()` to stream the archive to its destination.
+		/// The document object can be reused for another file, results of the previous
+		/// document are discarded.
+		bool parseDocument(const SourceTextFile & file);
+		/// Streams archive for previously parsed document to |sink|.
+		bool writeArchive(tap::ArchiveSink & sink) const;
 		const ByteRange archiveBytes() const;
 		const std::string & outputFile() const;
 		bool hasOutputFile() const;
+		/// Returns paths of all files referenced by `basic` and `code` commands in the last
+		/// parsed document, in document order and without duplicates. Paths of files that
+		/// couldn't be opened are included too.
+		const std::vector<std::string> & dependencies() const;
 		
 	private:
 		
+		/// The `Command` structure contains one line from the document. The `basic` and `code`
+		/// commands are captured first and then their files are loaded and compiled, possibly
+		/// in parallel. Each command keeps its messages, until they're reported in order.
+		struct Command
+		{
+			enum Type
+			{
+				/// Line doesn't produce a file, like `output` command, or comment.
+				None,
+				/// The `basic` command.
+				Program,
+				/// The `code` command.
+				Code,
+			};
+			Type type = None;
+			/// Path to file with program or bytes.
+			std::string path;
+			/// Name of file in the archive.
+			std::string name;
+			/// Address for the `code` command.
+			long address = 0;
+			/// Position of the command, used for errors reported while compiling.
+			ErrorInfo errorInfo;
+			/// Messages reported for this line.
+			BufferedErrorLogger log;
+			/// If false, then the line has error and the document processing must stop.
+			bool result = true;
+			/// Compiled file.
+			std::optional<tap::FileEntry> entry;
+		};
+		
 		bool doParseDocument();
-		bool doParseLine();
+		bool doParseLine(Command & command);
 		
-		bool doParseCmdProgram();
-		bool doParseCmdCode();
+		bool doParseCmdProgram(Command & command);
+		bool doParseCmdCode(Command & command);
 		bool doParseCmdOutput();
+		/// Adds |path| to the list of dependencies.
+		void addDependency(const std::string & path);
+		
+		/// Loads and compiles file for |command|. The function is called from the thread pool,
+		/// so it must not access the tokenizer, or modify the document.
+		bool compileCommand(Command & command) const;
+		bool compileProgram(Command & command) const;
+		bool compileCode(Command & command) const;
+		/// Creates program entry for |command|.
+		void setProgramEntry(Command & command, ByteArray && bytes, long autostart_line) const;
 		
 		/// Returns simple ErrorInfo structure.
 		ErrorInfo errInfo() const {
@@ -52,18 +127,23 @@ namespace bastapir
 			return MakeError(_sourceFileInfo, pos_info.lineNumber, pos_info.offsetAtLine);
 		}
 		
-		std::string 	captureWord(bool lowercase);
+		std::string_view captureWord();
 		bool		 	captureNumber(long & value);
+		bool		 	parseNumber(std::string_view word, int base, long & value, const char * error_message);
 		bool		 	captureString(std::string & captured);
 		bool		 	captureWordOrString(std::string & captured);
 		// Members
 		
 		ErrorLogging * _log;
+		ThreadPool * _pool;
+		const BuildCache * _cache;
+		SourceFile::Loading _fileLoading;
 		tap::TapArchiveBuilder _tapBuilder;
 		SourceFileInfo _sourceFileInfo;
 		
 		Tokenizer _tokenizer;
 		ByteArray _archiveBytes;
 		std::string _outputFile;
+		std::vector<std::string> _dependencies;
 	};
 }
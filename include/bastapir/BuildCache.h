@@ -0,0 +1,101 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/bas/BasicTextParser.h>
+#include <bastapir/common/ErrorLogging.h>
+#include <map>
+#include <mutex>
+
+namespace bastapir
+{
+	/// The `BuildCache` class keeps compiled BASIC programs in a directory on disk, so
+	/// unchanged programs don't need to be parsed again. Each program is stored in its own
+	/// file, named by a key computed from the program's path, content and parser setup.
+	/// Recently used programs are also kept in memory, so a long running process, like
+	/// the watch mode, doesn't have to load them from disk.
+	///
+	/// The cache can be used from multiple threads and multiple processes at once, because
+	/// each entry is written to a temporary file, which is then atomically renamed.
+	class BuildCache
+	{
+	public:
+		
+		/// The `Key` structure identifies one cache entry. The key is a 128-bit
+		/// non-cryptographic hash, so it must not be used for untrusted content.
+		struct Key
+		{
+			U64 hash[2];
+			
+			/// Returns key as a hexadecimal string.
+			std::string toString() const;
+		};
+		
+		/// The `Program` structure contains compiled BASIC program.
+		struct Program
+		{
+			/// Program bytes.
+			ByteArray bytes;
+			/// Line resolved from `autostart` variable, or `FileEntry::Params::NO_AUTOSTART`.
+			long autostartLine;
+			/// Messages reported while the program was parsed. They're reported again
+			/// when the program is loaded from the cache.
+			std::vector<BufferedErrorLogger::Message> messages;
+		};
+		
+		/// Constructs cache stored in |directory|. The directory is created when the first
+		/// entry is stored. If |directory| is empty, then programs are kept only in memory.
+		BuildCache(const std::string & directory = std::string());
+		
+		/// Returns directory with cache entries.
+		const std::string & directory() const;
+		
+		/// Returns key for program at |path| with |source| content, parsed with given
+		/// |dialect|, |options| and injected |constants|.
+		static Key programKey(const std::string & path, ByteRange source, bas::Keywords::Dialect dialect,
+							  const bas::BasicTextParser::Options & options,
+							  const std::vector<bas::BasicTextParser::Variable> & constants);
+		
+		/// Loads program stored under |key| to |program|. Returns false if there's no such
+		/// entry, or if the entry is not valid.
+		bool loadProgram(const Key & key, Program & program) const;
+		
+		/// Stores |program| under |key|. Returns false if the entry can't be written.
+		bool storeProgram(const Key & key, const Program & program) const;
+		
+	private:
+		
+		/// Returns path to file with entry for |key|.
+		std::string entryPath(const Key & key) const;
+		
+		/// Loads program from file on disk.
+		bool loadEntry(const Key & key, Program & program) const;
+		/// Stores program to file on disk.
+		bool storeEntry(const Key & key, const Program & program) const;
+		/// Keeps copy of |program| in memory.
+		void keepInMemory(const Key & key, const Program & program) const;
+		
+		std::string _directory;
+		
+		mutable std::mutex _memoryMutex;
+		/// Programs kept in memory.
+		mutable std::map<std::pair<U64, U64>, Program> _memory;
+		/// Total size of program bytes kept in memory.
+		mutable size_t _memorySize;
+	};
+	
+} // bastapir
@@ -20,7 +20,7 @@
 #include <bastapir/common/ErrorLogging.h>
 #include <bastapir/common/SourceFile.h>
 #include <bastapir/bas/Keywords.h>
-#include <map>
+#include <bastapir/bas/SymbolTable.h>
 #include <tuple>
 
 namespace bastapir
@@ -44,8 +44,8 @@ namespace bas
 			bool isResolved;
 			
 			/// Static method returns structure representing unresolved variable.
-			static Variable variable(const std::string & name) {
-				return Variable { name, "", false };
+			static Variable variable(std::string_view name) {
+				return Variable { std::string(name), "", false };
 			}
 			
 			/// Static method returns structure representing resolved constant.
@@ -70,6 +70,21 @@ namespace bas
 			/// (not implemented yet) If true, then all serialized numbers will have "0"
 			/// in textual representation.
 			bool	shadowNumbers = false;
+			/// If true, then the source code is processed only once and forward references to
+			/// symbolic line numbers are patched after the last line. If false, then the first pass
+			/// only collects symbols and the second pass generates program bytes.
+			bool	singlePass = true;
+		};
+		
+		/// The `Statistics` structure contains counters collected during the last `parse()`.
+		struct Statistics
+		{
+			/// Number of integers from 0 to 65535, encoded directly without the number cache.
+			size_t smallIntegers = 0;
+			/// Number of other numbers found in the number cache.
+			size_t numberCacheHits = 0;
+			/// Number of other numbers converted to binary form.
+			size_t numberCacheMisses = 0;
 		};
 		
 		/// Construcst BasicTextParser object. Parameter |log| is required and you have to provide
@@ -93,15 +108,31 @@ namespace bas
 		
 		/// Resolves variable or constant with given |name|. The function returns tuple, where the first parameter
 		/// is boolean determining whether variable was found and second is actual resolved value.
-		std::tuple<bool, std::string> resolveVariable(const std::string & variable_name) const;
+		std::tuple<bool, std::string> resolveVariable(std::string_view variable_name) const;
 		
 		/// Parses provided |source| and generates final program bytes. You have to specify |source_info| which may contain
 		/// an information about source code. Optionally, you can change |variant| of Spectrun BASIC.
 		/// Returns true if succeeded, false otherwise.
-		bool parse(const std::string & source, const SourceFileInfo & source_info, Keywords::Dialect dialect = Keywords::Dialect_48K);
+		bool parse(std::string_view source, const SourceFileInfo & source_info, Keywords::Dialect dialect = Keywords::Dialect_48K);
+		
+		/// Parses provided |source| with precomputed |line_index|. The index must be created for
+		/// the same |source| string. Returns true if succeeded, false otherwise.
+		bool parse(std::string_view source, const SourceFileInfo & source_info, std::shared_ptr<const LineIndex> line_index, Keywords::Dialect dialect = Keywords::Dialect_48K);
+		
+		/// Parses content of provided source |file|. The line index of the file is reused, so
+		/// the file can be parsed multiple times without scanning it for lines again.
+		/// Returns true if succeeded, false otherwise.
+		bool parse(const SourceTextFile & file, Keywords::Dialect dialect = Keywords::Dialect_48K);
 		
 		/// Returns generated BASIC program bytes. The returned bytes are valid only when last `parse()` returned true.
 		const ByteArray & programBytes() const;
+		
+		/// Moves generated BASIC program bytes out of the parser, so they can be stored without
+		/// copying. The `programBytes()` is empty after this call.
+		ByteArray releaseProgramBytes();
+		
+		/// Returns counters collected during the last `parse()`.
+		const Statistics & statistics() const;
 
 	private:
 
@@ -110,6 +141,9 @@ namespace bas
 		/// Main parser function
 		bool doParse();
 		
+		/// Validates result of the parsing, after the last pass.
+		bool doValidateProgram();
+		
 		/// Parses one line in the document
 		bool doParseLine();
 		
@@ -159,21 +193,59 @@ namespace bas
 		/// Returns false in case of error.
 		bool writeLastLineBytes();
 		
-		/// Writes floating point number |n| with its |textual_representation| to the output stream.
-		/// Returns false if number |n| cannot be serialized.
-		bool writeNumber(double n, const std::string & textual_representation);
+		/// Writes number with its |textual_representation| to the output stream.
+		/// Returns false if number cannot be serialized.
+		bool writeNumber(std::string_view textual_representation);
 		
+		/// Writes integer |value| to the output stream, in its decimal textual representation.
+		/// Returns false if number cannot be serialized.
+		bool writeInteger(U32 value);
 		
-		// MARK: - Variable management
+		/// Binary form of number, starting with `Keywords::Code_NUM` byte.
+		typedef SymbolTable::NumberBytes NumberBytes;
+		
+		/// Returns number of bytes produced by `serializeNumber()` for given |textual_representation|.
+		size_t serializedNumberSize(std::string_view textual_representation) const;
+		
+		/// Returns exact size of program, after the pass which only declares symbols and counts bytes.
+		size_t countedProgramSize() const;
+		
+		/// Appends number with its |textual_representation| and already encoded |number_bytes|
+		/// to |out| array.
+		void serializeNumber(std::string_view textual_representation, const NumberBytes & number_bytes, ByteArray & out) const;
+		
+		/// Serializes number with its |textual_representation| and already encoded |number_bytes|
+		/// to |out| buffer, which must have at least `serializedNumberSize()` bytes.
+		void serializeNumber(std::string_view textual_representation, const NumberBytes & number_bytes, byte * out) const;
+		
+		/// Writes value of resolved symbol with given |id| to the output stream.
+		/// Returns false if value cannot be serialized.
+		bool writeSymbol(SymbolTable::SymbolID id);
 		
-		/// Variable lookup (const version). Function search for name in constants & vars maps.
-		const Variable * findVariable(const std::string & name) const;
+		/// Encodes value of resolved symbol with given |id| to its binary form. The value is
+		/// encoded only once, then the symbol keeps its binary form.
+		/// Returns false if value cannot be serialized.
+		bool encodeSymbol(SymbolTable::SymbolID id);
 		
-		/// Variable lookup. Function search for name in constants & vars maps.
-		Variable * findVariable(const std::string & name);
+		/// Encodes number with given |textual_representation| to |out| binary form. Small integers are
+		/// encoded directly, other numbers are looked up in the number cache first, so repeated
+		/// numbers are converted only once. Returns false if number cannot be serialized.
+		bool encodeNumber(std::string_view textual_representation, NumberBytes & out);
 		
-		/// Adds new variable.
-		bool addVariable(const Variable & var, bool is_line_number);
+		/// Registers forward reference to symbol with given |id|, at the current position in
+		/// the output stream. The reference is resolved later in `applyFixups()`.
+		void addFixup(SymbolTable::SymbolID id);
+		
+		/// Resolves all forward references registered in single-pass mode and splices their
+		/// values into the output stream. Returns false in case of error.
+		bool applyFixups();
+		
+		
+		// MARK: - Variable management
+		
+		/// Declares symbolic line number with given |name|. The value of symbol is set to
+		/// the current BASIC line number.
+		bool declareLineNumber(std::string_view name);
 		
 		/// Returns true if all variables are resolved and have value.
 		/// If |dump_error| parameter is true, then an appropriate error is generated.
@@ -195,9 +267,6 @@ namespace bas
 		
 		// MARK: - Members
 		
-		/// Internal type for [name: variable] map.
-		typedef std::map<std::string, Variable> VarMap;
-		
 		/// Logging facility.
 		ErrorLogging * _log;
 		/// Information about source file.
@@ -205,10 +274,10 @@ namespace bas
 		
 		/// Parser's options
 		Options _options;
-		/// Constants injected into the BASIC
-		VarMap _constants;
-		/// Variables & line number symbos.
-		VarMap _variables;
+		/// Constants injected into the BASIC, followed by variables & line number symbols.
+		SymbolTable _symbols;
+		/// Number of constants at the beginning of `_symbols`.
+		size_t _constantsCount = 0;
 		/// Keywords helper
 		Keywords _keywords;
 		
@@ -218,7 +287,7 @@ namespace bas
 		/// Private context structure.
 		struct CTX
 		{
-			/// Parser's pass. Must be 1 or 2
+			/// Parser's pass. Must be 1 or 2 in two-pass mode, or 0 in single-pass mode.
 			U16 pass = 0;
 			/// Current basic line number
 			U16 basicLineNumber = 0;
@@ -233,6 +302,18 @@ namespace bas
 			bool lineBegin = true;
 			/// If true, then current line really generates BASIC program bytes.
 			bool lineContainsBytes = false;
+			/// Number of program bytes produced in this pass. If bytes are not written
+			/// in the pass, then they're only counted.
+			size_t outputSize = 0;
+			
+			/// Returns true if symbols are declared in this pass.
+			bool isDeclaring() const {
+				return pass <= 1;
+			}
+			/// Returns true if program bytes are written in this pass.
+			bool isWriting() const {
+				return pass != 1;
+			}
 		};
 		/// Parser's context
 		CTX _ctx;
@@ -244,8 +325,42 @@ namespace bas
 			return ctx;
 		}
 		
+		/// The `Fixup` structure represents forward reference to symbol, which has to be
+		/// written to the output stream once the symbol is resolved.
+		struct Fixup
+		{
+			/// Referenced symbol.
+			SymbolTable::SymbolID symbol;
+			/// Offset to `_output` where the number has to be inserted.
+			size_t offset;
+			/// Offset to `_output` marking beginning of line containing the reference,
+			/// or 0 if the reference is not in line.
+			size_t beginLineBytesOffset;
+		};
+		/// Forward references collected in single-pass mode.
+		std::vector<Fixup> _fixups;
+		
 		/// Output BASIC program bytes.
 		ByteArray _output;
+		
+		/// The `NumberCacheEntry` structure contains one number converted in the current parse.
+		struct NumberCacheEntry
+		{
+			/// Parse generation in which the entry was stored. Entries from older parses are invalid.
+			U32 generation;
+			/// Length of textual representation.
+			U8 length;
+			/// Textual representation of number.
+			char text[21];
+			/// Binary form of number.
+			NumberBytes bytes;
+		};
+		/// Direct-mapped cache of converted numbers, indexed by hash of textual representation.
+		std::vector<NumberCacheEntry> _numberCache;
+		/// Generation of the current parse. Increasing the generation invalidates the whole cache.
+		U32 _numberCacheGeneration = 0;
+		/// Counters for the current parse.
+		Statistics _statistics;
 	};
 	
 } // bastapir::bas
@@ -22,12 +22,17 @@ namespace bastapir
 {
 namespace bas
 {
+	/// Node of keywords trie. The structure is private to Keywords implementation.
+	struct KeywordTrieNode;
+	
 	/// The `Keywords` class is translating textual BASIC keywords to byte codes.
 	/// The class also contains table for converting escape codes suppored in
 	/// BASIC strings to byte codes. For example, you can use "\a" to generate
 	/// UDG character "A".
 	///
 	/// The instance must be initialized for one of supported BASIC dialects.
+	/// All tables are built at compile time and shared between instances, so
+	/// constructing Keywords is cheap and the object can be freely copied.
 	class Keywords
 	{
 	public:
@@ -44,8 +49,8 @@ namespace bas
 		/// Constructs Keywords for given |dialect|
 		Keywords(Dialect dialect);
 		
-		/// Changes dialect of keywords. The method also regenerates internal
-		/// keywords & escape codes tables.
+		/// Changes dialect of keywords. The method only switches to the keywords
+		/// table prepared for the dialect.
 		void setDialect(Dialect dialect);
 		
 		/// Returns dialect assigned to Keywords object.
@@ -68,49 +73,13 @@ namespace bas
 		
 		// MARK: - Private interface
 		
-		/// Internal structure representing BASIC keyword
-		struct Keyword
-		{
-			std::string keyword;		// an actual keyword
-			bool special;				// if true, keyword contains non-alpha characters
-			byte code;					// translated code
-		};
-		
-		/// Sort predicate for sorting Keywords by length. Longer keywords are first.
-		struct LongerKeywordPredicate
-		{
-			inline bool operator() (const Keyword & k1, const Keyword & k2)
-			{
-				return k1.keyword.size() > k2.keyword.size();
-			}
-		};
-		
-		/// Internal structure representing escaped string sequence.
-		/// For example, \t is translated to UDG character T
-		struct EscapeCode
-		{
-			std::string sequence;		// sequence of characters after backslash.
-			byte code;					// translated code
-		};
-		
 		/// Stored BASIC dialect
 		Dialect					_dialect;
-		/// All BASIC keywords
-		std::vector<Keyword>	_keywords;
-		/// Unique first characters from each keyword. The string helps
-		/// with keywords search.
-		std::string 			_keywordsFirstChars;
-		/// All escape codes
-		std::vector<EscapeCode>	_escapeCodes;
+		/// Keywords trie for the dialect, built at compile time.
+		const KeywordTrieNode *	_keywordTrie;
 		
 		/// Setups internal structures for given BASIC dialect.
 		void setupStructures(Dialect d);
-		
-		/// Prepares & returns list of Keyword structures for given BASIC dialect.
-		static std::vector<Keyword> prepareKeywords(Dialect d);
-		
-		/// Prepares & returns list of EscapeCode structures for given BASIC dialect.
-		static std::vector<EscapeCode> prepareEscapeCodes(Dialect d);
 	};
 	
 	
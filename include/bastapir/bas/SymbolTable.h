@@ -0,0 +1,131 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+#include <array>
+
+namespace bastapir
+{
+namespace bas
+{
+	/// The `SymbolTable` class keeps symbols referenced from BASIC source code, like symbolic
+	/// line numbers or injected constants. Each name is interned only once and then the symbol
+	/// is identified by its integer ID, which is also an index to the table.
+	///
+	/// Names are looked up in a flat open-addressing hash table, so the lookup doesn't allocate
+	/// memory and can be done directly with characters from the source code.
+	class SymbolTable
+	{
+	public:
+
+		// MARK: - Supporting types
+
+		/// Identifier of symbol.
+		typedef U32 SymbolID;
+
+		/// Identifier returned when symbol is not in the table.
+		static const SymbolID NotFound = 0xFFFFFFFF;
+
+		/// Binary form of number, starting with `Keywords::Code_NUM` byte.
+		typedef std::array<byte, 6> NumberBytes;
+
+		/// The `Symbol` structure contains information about one symbol.
+		struct Symbol
+		{
+			/// Symbol's name.
+			std::string name;
+			/// Textual representation of symbol's value.
+			std::string value;
+			/// Binary form of value. Valid only if `isEncoded` is true.
+			NumberBytes number;
+			/// If true, then `value` property is valid.
+			bool isResolved = false;
+			/// If true, then `number` contains binary form of `value`.
+			bool isEncoded = false;
+			/// Number of references to the symbol, counted by the parser when the program
+			/// is not written yet.
+			U32 references = 0;
+
+			/// Assigns a new textual value to the symbol. The binary form must be encoded later.
+			void setValue(std::string_view v) {
+				value = std::string(v);
+				isResolved = true;
+				isEncoded = false;
+			}
+		};
+
+		// MARK: - Public interface
+
+		/// Constructs an empty table.
+		SymbolTable();
+
+		/// Removes all symbols from the table.
+		void clear();
+
+		/// Removes all symbols added after first |count| symbols.
+		void truncate(size_t count);
+
+		/// Returns number of symbols in the table.
+		size_t size() const;
+
+		/// Returns ID of symbol with given |name|, or `NotFound` if there's no such symbol.
+		SymbolID find(std::string_view name) const;
+
+		/// Returns ID of symbol with given |name|. If there's no such symbol, then adds
+		/// a new, unresolved one. The |added| parameter is set to true in that case.
+		SymbolID intern(std::string_view name, bool & added);
+
+		/// Returns ID of symbol with given |name|, adding a new symbol if necessary.
+		SymbolID intern(std::string_view name);
+
+		/// Returns symbol with given |id|. Note that the reference is valid only until
+		/// the next symbol is added to the table.
+		Symbol & symbol(SymbolID id);
+
+		/// Returns symbol with given |id| (const version).
+		const Symbol & symbol(SymbolID id) const;
+
+	private:
+
+		/// The `Slot` structure is one slot in the hash table.
+		struct Slot
+		{
+			/// Hash of symbol's name.
+			U32 hash;
+			/// ID of symbol, or `NotFound` if slot is empty.
+			SymbolID id;
+		};
+
+		/// Returns hash of |name|.
+		static U32 hashName(std::string_view name);
+
+		/// Returns index of slot containing symbol with |name| and |hash|, or index of the empty
+		/// slot where such symbol can be inserted.
+		size_t findSlot(std::string_view name, U32 hash) const;
+
+		/// Allocates |capacity| slots and inserts all existing symbols.
+		void rehash(size_t capacity);
+
+		/// All symbols, indexed by ID.
+		std::vector<Symbol> _symbols;
+		/// Hash table. The number of slots is always power of two.
+		std::vector<Slot> _slots;
+	};
+
+} // bastapir::bas
+} // bastapir
@@ -91,6 +91,8 @@ namespace bastapir
 		{
 		}
 		
+		ByteRange & operator=(const ByteRange & r) noexcept = default;
+		
 		explicit ByteRange(const void * ptr, size_type size) noexcept :
 			_begin (reinterpret_cast<const_pointer>(ptr)),
 			_end   (_begin ? _begin + size : nullptr)
@@ -398,6 +400,15 @@ namespace bastapir
 	{
 		return ByteRange(str);
 	}
+	
+	/**
+	 Creates a new ByteRange object from given string view. The returned
+	 range points to the same characters as the view.
+	 */
+	inline ByteRange MakeRange(std::string_view str)
+	{
+		return ByteRange(str.data(), str.size());
+	}
 		
 	/**
 	 The template function captures any fundamental data type, or POD
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <bastapir/common/ErrorInfo.h>
+#include <atomic>
 
 namespace bastapir
 {
@@ -58,9 +59,32 @@ namespace bastapir
 	};
 	
 	
+	// MARK: - Counters
+	
+	/// The `ErrorCounters` structure keeps number of errors and warnings. The counters
+	/// can be incremented from multiple threads at once.
+	struct ErrorCounters
+	{
+		std::atomic<int> warningsCount { 0 };
+		std::atomic<int> errorsCount { 0 };
+		
+		/// Returns snapshot of the counters.
+		ErrorLogging::Info info() const {
+			return { warningsCount.load(std::memory_order_relaxed), errorsCount.load(std::memory_order_relaxed) };
+		}
+		/// Sets both counters to zero.
+		void reset() {
+			warningsCount.store(0, std::memory_order_relaxed);
+			errorsCount.store(0, std::memory_order_relaxed);
+		}
+	};
+	
+	
 	// MARK: - File looger
 	
-	/// Concrete implementation of ErrorLogging interface.
+	/// Concrete implementation of ErrorLogging interface. The logger can be used from
+	/// multiple threads at once, because each message is written to the stream at once,
+	/// so messages never interleave. The configuration must not change while logging.
 	class FileErrorLogger: public ErrorLogging
 	{
 	public:
@@ -101,11 +125,14 @@ namespace bastapir
 		Severity _min_severity;
 		bool _close_streams;
 		
-		ErrorLogging::Info _info;
+		ErrorCounters _counters;
 	};
 	
 	// MARK: - Redirecting logger
 	
+	/// The `RedirectingErrorLogger` class forwards all messages to child loggers. The logger
+	/// can be used from multiple threads at once, if all children are thread safe, but the list
+	/// of children must not change while logging.
 	class RedirectingErrorLogger: public ErrorLogging
 	{
 	public:
@@ -130,6 +157,63 @@ namespace bastapir
 		
 	private:
 		std::vector<ErrorLogging*> _loggers;
+		ErrorCounters _counters;
+	};
+	
+	// MARK: - Buffered logger
+	
+	/// The `BufferedErrorLogger` class keeps all reported messages in memory, until they're
+	/// flushed to another logger. Work executed in parallel can log into its own buffered
+	/// logger and then the messages can be flushed in a deterministic order. Unlike other
+	/// loggers, this one is not thread safe.
+	class BufferedErrorLogger: public ErrorLogging
+	{
+	public:
+		
+		/// The `Message` structure contains one buffered message.
+		struct Message
+		{
+			Severity severity;
+			ErrorInfo info;
+			std::string message;
+		};
+		
+		BufferedErrorLogger();
+		~BufferedErrorLogger();
+		
+		/// Returns true if there's no message in the buffer.
+		bool isEmpty() const;
+		
+		/// Returns all buffered messages, in order of reporting.
+		const std::vector<Message> & messages() const;
+		
+		/// Removes all buffered messages, without reporting them.
+		void clear();
+		
+		/// Appends previously captured |message| to the buffer.
+		void append(const Message & message);
+		
+		/// Reports all buffered messages to |target| logger, in the same order as they
+		/// were reported, and then removes them from the buffer.
+		void flush(ErrorLogging * target);
+		
+		// ErrorLogging interface
+		virtual void error(const std::string & message);
+		virtual void error(const ErrorInfo & info, const std::string & message);
+		virtual void warning(const std::string & message);
+		virtual void warning(const ErrorInfo & info, const std::string & message);
+		virtual void info(const std::string & message);
+		virtual void info(const ErrorInfo & info, const std::string & message);
+		virtual void debug(const std::string & message);
+		virtual void debug(const ErrorInfo & info, const std::string & message);
+		
+		virtual ErrorLogging::Info getInfo() const;
+		virtual void resetInfo();
+		
+	private:
+		
+		std::vector<Message> _messages;
 		ErrorLogging::Info _info;
 	};
+
 }
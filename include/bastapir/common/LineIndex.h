@@ -0,0 +1,84 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+
+namespace bastapir
+{
+	/// The `LineIndex` class contains offsets to beginning and end of each line
+	/// in the text buffer. The index is built once, with one sweep over the buffer,
+	/// and then can be shared between multiple `Tokenizer` objects processing
+	/// the same text.
+	///
+	/// Lines can be terminated with LF, CR-LF or with standalone CR. The standalone CR
+	/// is treated as line end, but the line is marked as line with invalid terminator.
+	/// If the text ends with line terminator, then the index contains also the last,
+	/// empty line.
+	class LineIndex
+	{
+	public:
+
+		/// Constructs an empty index.
+		LineIndex();
+
+		/// Constructs index for given string.
+		LineIndex(const std::string & str);
+
+		/// Constructs index for range of characters.
+		LineIndex(const char * begin, const char * end);
+
+		/// Returns number of lines in the index. The index always contains at least one line.
+		size_t lineCount() const {
+			return _begins.size();
+		}
+
+		/// Returns size of indexed text buffer.
+		size_t bufferSize() const {
+			return _bufferSize;
+		}
+
+		/// Returns offset to the first character of line at |line| index.
+		size_t lineBegin(size_t line) const {
+			return _begins[line];
+		}
+
+		/// Returns offset to the line terminator of line at |line| index. If the line
+		/// has no terminator, then the returned offset is equal to the buffer size.
+		size_t lineEnd(size_t line) const {
+			return _ends[line];
+		}
+
+		/// Returns true if line at |line| index is terminated with standalone CR.
+		bool hasInvalidLineEnd(size_t line) const;
+
+	private:
+
+		/// Builds index for given range of characters.
+		void build(const char * begin, const char * end);
+
+		/// Offsets to the beginning of lines.
+		std::vector<U32> _begins;
+		/// Offsets to the line terminators.
+		std::vector<U32> _ends;
+		/// Sorted indexes of lines terminated with standalone CR.
+		std::vector<size_t> _invalidLineEnds;
+		/// Size of indexed buffer.
+		size_t _bufferSize;
+	};
+
+} // bastapir
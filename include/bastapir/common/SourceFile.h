@@ -19,6 +19,8 @@
 #include <bastapir/common/ByteArray.h>
 #include <bastapir/common/ErrorInfo.h>
 #include <bastapir/common/Path.h>
+#include <bastapir/common/LineIndex.h>
+#include <memory>
 
 namespace bastapir
 {
@@ -55,12 +57,30 @@ namespace bastapir
 	
 	// MARK: - Generic source file
 	
+	/// The `SourceFile` class keeps content of file loaded from the filesystem. On UNIX platforms,
+	/// large regular files are mapped into memory, so the content is never copied. Other files,
+	/// like pipes or standard input, are read into a buffer. In both cases, the content is kept in a shared storage,
+	/// which may outlive the file object.
+	///
+	/// Note that the mapped content reflects later changes in the file and truncating the file
+	/// makes access to the mapped content crash the process. If files may be rewritten while
+	/// the content is in use, for example in long running processes, then use `ReadIntoBuffer`.
 	class SourceFile
 	{
 	public:
+		/// Defines how the file content is loaded.
+		enum Loading
+		{
+			/// Regular files above the size threshold are mapped into memory on UNIX platforms,
+			/// other files are read.
+			MapLargeFiles,
+			/// Content is always read into a buffer, so later changes in the file don't affect it.
+			ReadIntoBuffer,
+		};
+		
 		/// Opens a source file defined in |info| structure. Method always
 		/// returns object, so you need to investigate whetner is valid afterwards.
-		static SourceFile open(const Path & path, SourceFileInfo::Mode mode);
+		static SourceFile open(const Path & path, SourceFileInfo::Mode mode, Loading loading = MapLargeFiles);
 		
 		virtual ~SourceFile();
 		
@@ -74,19 +94,38 @@ namespace bastapir
 		/// Returns true if file has valid content.
 		bool isValid() const;
 		
+		/// Returns object owning the file content. The content can be shared with other objects,
+		/// for example with `tap::FileEntry`, and stays valid even when this file object is destroyed.
+		std::shared_ptr<const void> storage() const;
+		
 	protected:
 		
 		/// Direct construction is not allowed.
 		SourceFile(const SourceFileInfo & info);
 		
 		/// Internal open function.
-		void open(std::string * out_str, ByteArray * out_bin);
+		void open(Loading loading);
+		
+		/// Returns loaded content. The range is empty if file is not valid.
+		ByteRange content() const;
 		
 	private:
 		
+		/// Storage for file content, defined in implementation.
+		class Content;
+		
+#if BASTAPIR_UNIX
+		/// Maps the file into memory, if it's a regular file above the size threshold.
+		/// Returns false if the file should be read into buffer instead.
+		bool mapContent();
+#endif
+		/// Reads whole file into buffer, with using portable stdio functions.
+		void readContent();
+		
 		const SourceFileInfo _info;
 		bool _is_valid;
 		std::string _error;
+		std::shared_ptr<const Content> _content;
 	};
 
 	
@@ -96,14 +135,19 @@ namespace bastapir
 	class SourceTextFile: public SourceFile
 	{
 	public:
-		SourceTextFile(const Path & path);
+		SourceTextFile(const Path & path, Loading loading = MapLargeFiles);
 		~SourceTextFile();
 		
-		/// Returns reference to string representation of file content.
-		const std::string & string() const;
+		/// Returns view to string representation of file content. The view is valid as long as
+		/// this object, or its `storage()`, exists.
+		std::string_view string() const;
+		
+		/// Returns line index for the file content. The index is created on the first access
+		/// and then shared by all users of this file.
+		std::shared_ptr<const LineIndex> lineIndex() const;
 
 	private:
-		std::string _content;
+		mutable std::shared_ptr<const LineIndex> _lineIndex;
 	};
 	
 	
@@ -113,14 +157,12 @@ namespace bastapir
 	class SourceBinaryFile: public SourceFile
 	{
 	public:
-		SourceBinaryFile(const Path & path);
+		SourceBinaryFile(const Path & path, Loading loading = MapLargeFiles);
 		~SourceBinaryFile();
 		
-		/// Returns bytes representation of file content.
-		const ByteArray & bytes() const;
-		
-	private:
-		ByteArray _content;
+		/// Returns bytes representation of file content. The range is valid as long as
+		/// this object, or its `storage()`, exists.
+		ByteRange bytes() const;
 	};
 	
 	
@@ -0,0 +1,86 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace bastapir
+{
+	/// The `ThreadPool` class keeps a fixed set of worker threads, which execute
+	/// independent jobs. The pool is intended for coarse grained work, like compiling
+	/// whole files, so each job is identified just by its index.
+	///
+	/// The thread calling `run()` participates in the work, so the pool with one thread
+	/// has no worker threads at all and executes all jobs in order, on the calling thread.
+	class ThreadPool
+	{
+	public:
+		
+		/// Constructs pool executing jobs on |threads| threads, including the calling thread.
+		/// If |threads| is 0, then the number of threads is equal to number of CPU cores.
+		ThreadPool(size_t threads = 0);
+		~ThreadPool();
+		
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool & operator=(const ThreadPool &) = delete;
+		
+		/// Returns number of threads executing jobs, including the calling thread.
+		size_t threadsCount() const;
+		
+		/// Executes |job| for all indexes from 0 to |count| - 1 and waits until all jobs are
+		/// finished. The order of execution is not defined, so the job should store its result
+		/// to a slot reserved for the index. The function must not be called concurrently, or
+		/// from a running job.
+		void run(size_t count, const std::function<void(size_t)> & job);
+		
+		/// Returns number of CPU cores, or 1 if the number is not known.
+		static size_t hardwareThreads();
+		
+	private:
+		
+		/// Main loop of worker thread.
+		void workerLoop();
+		
+		/// Executes jobs from the current batch, until there's no job left.
+		void executeJobs();
+		
+		std::vector<std::thread> _workers;
+		std::mutex _mutex;
+		std::condition_variable _batchStarted;
+		std::condition_variable _batchFinished;
+		
+		/// Job for the current batch.
+		const std::function<void(size_t)> * _job;
+		/// Number of jobs in the current batch.
+		size_t _jobsCount;
+		/// Index of the next job to execute.
+		std::atomic<size_t> _nextJob;
+		/// Number of workers still working on the current batch.
+		size_t _activeWorkers;
+		/// Incremented with each batch, so workers can detect a new one.
+		U64 _batchGeneration;
+		/// If true, workers should exit.
+		bool _stop;
+	};
+	
+} // bastapir
@@ -18,6 +18,8 @@
 
 #include <bastapir/common/Types.h>
 #include <bastapir/common/ErrorLogging.h>
+#include <bastapir/common/LineIndex.h>
+#include <memory>
 
 namespace bastapir
 {
@@ -27,8 +29,8 @@ namespace bastapir
 		
 		// MARK: - Supporting types
 		
-		typedef std::string::const_iterator		iterator;
-		typedef std::string::difference_type	difference;
+		typedef const char *					iterator;
+		typedef std::ptrdiff_t					difference;
 		
 		/// The `Range` structure contains `begin` & `end` of string.
 		struct Range
@@ -37,12 +39,18 @@ namespace bastapir
 			iterator end;
 			
 			/// Returns string between begin & end.
-			std::string content() {
+			std::string content() const {
 				return std::string(begin, end);
 			}
 			
+			/// Returns non-owning view to characters between begin & end. Unlike `content()`, the view
+			/// doesn't allocate memory, but it's valid only as long as the tokenized string.
+			std::string_view view() const {
+				return std::string_view(begin, end - begin);
+			}
+			
 			/// Returns true if `begin` is equal to `end`
-			bool empty() {
+			bool empty() const {
 				return begin == end;
 			}
 		};
@@ -84,6 +92,14 @@ namespace bastapir
 		/// Resets tokenizer for a new string processing.
 		void resetTo(const iterator begin, const iterator end);
 		
+		/// Resets tokenizer for a new string processing, with precomputed |line_index|. The index
+		/// must be created for exactly the same range of characters. With the index, moving between
+		/// lines doesn't need to scan the string.
+		void resetTo(const Range range, std::shared_ptr<const LineIndex> line_index);
+		
+		/// Returns line index assigned in `resetTo()`, or nullptr if tokenizer has no index.
+		const std::shared_ptr<const LineIndex> & lineIndex() const;
+		
 		/// Resets position to the beginning of string
 		void reset();
 		
@@ -153,6 +169,20 @@ namespace bastapir
 		/// Skip whitespace characters. The current position will end at first non-whitespace character or at the end.
 		bool skipWhitespace();
 		
+		/// Skip alphanumeric characters. Works like `skipWhile(isalnum)`, but processes multiple characters at once.
+		bool skipAlphanumeric();
+		
+		/// Skip decimal digits. Works like `skipWhile(isdigit)`, but processes multiple characters at once.
+		bool skipDigits();
+		
+		/// Skip hexadecimal digits. Works like `skipWhile(isxdigit)`, but processes multiple characters at once.
+		bool skipHexDigits();
+		
+		/// Skip regular characters in string literal. The current position will end at first double quote,
+		/// backslash, NUL character, or at the end. Returns false if the end has been reached. Unlike other
+		/// skip methods, the NUL character is not reported, because it's expected that caller will read it.
+		bool skipStringCharacters();
+		
 		/// Skip characters while provided |match_function| returns true. The current position will end at the last
 		/// matched character.
 		bool skipWhile(int (*match_function)(int));
@@ -192,11 +222,22 @@ namespace bastapir
 		
 		/// Updates internal line end pointer.
 		void updateLineEnd();
+		
+		/// Pointer to function scanning range of characters.
+		typedef const char * (*ScanKernel)(const char * begin, const char * end);
+		
+		/// Moves position to the character returned from |kernel| applied to the rest of current limit.
+		void scanWith(ScanKernel kernel);
+		
+		/// Implementation of `nextLine()` for tokenizer with line index.
+		bool nextIndexedLine();
 
 		bool	_stop_at_lf;
 		Range	_str;
 		State	_state;
 		
+		std::shared_ptr<const LineIndex> _lineIndex;
+		
 		ErrorLogging * _log;
 		
 	};
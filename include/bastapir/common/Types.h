@@ -18,12 +18,14 @@
 
 #include <bastapir/common/detail/Platform.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <assert.h>
 
 namespace bastapir
 {
+	typedef uint64_t	U64;
 	typedef uint32_t	U32;
 	typedef uint16_t	U16;
 	typedef uint8_t		U8;
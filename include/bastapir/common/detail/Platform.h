@@ -40,6 +40,15 @@
 	#define BASTAPIR_UNIX	1
 	#define BASTAPIR_WIN	0
 
+#elif defined(__linux__) || defined(__unix__)
+
+	#include <stdlib.h>
+	#include <string.h>
+	#include <stdint.h>
+
+	#define BASTAPIR_UNIX	1
+	#define BASTAPIR_WIN	0
+
 #elif defined(WINAPI_FAMILY)
 
 	#include <sdkddkver.h>
@@ -0,0 +1,73 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/ByteArray.h>
+
+namespace bastapir
+{
+namespace tap
+{
+	/// The `ArchiveSink` class is an abstract destination for "TAP" archive bytes.
+	/// The archive builder passes each tape block as a small group of buffers
+	/// (length prefix, flag byte, payload and checksum), so the payload is never
+	/// copied into a temporary block.
+	class ArchiveSink
+	{
+	public:
+		virtual ~ArchiveSink() {}
+
+		/// Writes all |count| |buffers|, in order. Returns false in case of error.
+		virtual bool write(const ByteRange * buffers, size_t count) = 0;
+	};
+
+	/// The `ByteArraySink` class appends all written bytes to a byte array.
+	class ByteArraySink: public ArchiveSink
+	{
+	public:
+		/// Constructs sink appending bytes to |out| array.
+		ByteArraySink(ByteArray & out);
+
+		// ArchiveSink interface
+		virtual bool write(const ByteRange * buffers, size_t count);
+
+	private:
+		ByteArray & _out;
+	};
+
+	/// The `FileDescriptorSink` class writes bytes to an open file descriptor, with
+	/// one scatter-gather `writev()` call per group of buffers on UNIX platforms, or
+	/// with one `_write()` call per buffer elsewhere. The sink doesn't close the descriptor.
+	class FileDescriptorSink: public ArchiveSink
+	{
+	public:
+		/// Constructs sink writing to file descriptor |fd|.
+		FileDescriptorSink(int fd);
+
+		/// Returns total number of bytes written to the descriptor.
+		size_t writtenBytes() const;
+
+		// ArchiveSink interface
+		virtual bool write(const ByteRange * buffers, size_t count);
+
+	private:
+		int _fd;
+		size_t _writtenBytes;
+	};
+
+} // bastapir::tap
+} // bastapir
@@ -0,0 +1,47 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include <bastapir/common/ByteRange.h>
+
+namespace bastapir
+{
+namespace tap
+{
+	//
+	// Checksum of tape blocks. The checksum is XOR of the leading (flag) byte and
+	// all bytes in the block.
+	//
+	// The functions process 32 bytes at once when AVX2 is enabled at compile time,
+	// 16 bytes with SSE2 or NEON and fall back to scalar loop, processing 8 bytes
+	// at once, otherwise.
+	//
+
+	/// Returns XOR checksum of |leading| byte and all |bytes|.
+	byte XorChecksum(byte leading, const ByteRange & bytes);
+
+	/// Copies all |bytes| to |destination| and returns XOR checksum of |leading| byte and
+	/// copied bytes. Both operations are done in one pass over the bytes. The destination
+	/// must have space for all bytes and must not overlap with the source range.
+	byte CopyWithChecksum(byte * destination, byte leading, const ByteRange & bytes);
+
+	/// Returns name of instruction set used by the checksum functions.
+	const char * ChecksumInstructionSet();
+
+} // bastapir::tap
+} // bastapir
@@ -18,6 +18,7 @@
 
 #include <bastapir/common/SourceFile.h>
 #include <bastapir/common/ErrorLogging.h>
+#include <memory>
 
 namespace bastapir
 {
@@ -80,15 +81,24 @@ namespace tap
 			};
 		};
 		
+		/// Constructs file entry with a copy of |bytes|.
 		FileEntry(const std::string & name, Type type, const ByteRange & bytes);
 		
+		/// Constructs file entry which takes ownership of |bytes|, without copying.
+		FileEntry(const std::string & name, Type type, ByteArray && bytes);
+		
+		/// Constructs file entry referencing |bytes| owned by |storage| object, without copying.
+		/// The entry keeps the storage alive, so the bytes can be shared by multiple entries, or
+		/// they can be kept in memory mapped file.
+		FileEntry(const std::string & name, Type type, const ByteRange & bytes, std::shared_ptr<const void> storage);
+		
 		/// Returns name of file stored in this entry.
 		const std::string & name() const;
 		
 		/// Returns type of file stored in this entry.
 		const Type type() const;
 		
-		/// Returns reference to stored bytes.
+		/// Returns reference to stored bytes. Copying the entry doesn't copy the bytes.
 		const ByteRange bytes() const;
 		
 		
@@ -151,7 +161,8 @@ namespace tap
 		Type	 		_fileType;
 		Params			_fileParams;
 		
-		ByteArray		_bytes;
+		std::shared_ptr<const void> _storage;
+		ByteRange		_bytes;
 		
 		SourceFileInfo	_sourceFile;
 	};
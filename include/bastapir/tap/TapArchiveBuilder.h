@@ -18,6 +18,7 @@
 
 #include <bastapir/common/ErrorLogging.h>
 #include <bastapir/tap/FileEntry.h>
+#include <bastapir/tap/ArchiveSink.h>
 
 namespace bastapir
 {
@@ -38,9 +39,37 @@ namespace tap
 		/// Adds file |entry| into the builder.
 		void addFile(const FileEntry & entry);
 		
-		/// Builds a whole "TAP" file for all previously added file entries.
+		/// Removes all files from the builder, so it can be used for another archive.
+		void removeAllFiles();
+		
+		/// Moves file |entry| into the builder.
+		void addFile(FileEntry && entry);
+		
+		/// Constructs a new file entry directly in the builder, from given |args|, and returns
+		/// reference to the entry. The reference is valid until the next file is added.
+		template <typename... Args>
+		FileEntry & emplaceFile(Args&&... args) {
+			_files.emplace_back(std::forward<Args>(args)...);
+			return _files.back();
+		}
+		
+		/// Builds a whole "TAP" file for all previously added file entries. The size of archive is
+		/// calculated in advance, so the output is allocated only once.
 		/// If empty array is returned, then there was a problem with file added to the builder.
 		ByteArray build() const;
+		
+		/// Returns exact size of "TAP" file for all previously added file entries.
+		size_t archiveSize() const;
+		
+		/// Validates all previously added file entries and reports all issues to the logger.
+		/// Returns false if some entry has critical error.
+		bool validate() const;
+		
+		/// Streams a whole "TAP" file to |sink|, block by block. Unlike `build()`, the archive is
+		/// never constructed in memory and payloads of files are passed to the sink without copying.
+		/// The file entries must be validated with `validate()` before the call.
+		/// Returns false if some block cannot be serialized or if the sink fails.
+		bool write(ArchiveSink & sink) const;
 
 		/// Generates "raw" byte stream for given |bytes|. Parameter |is_header| affects whether the bytes contains
 		/// tape header or block of data. If |is_tap_block| is false, then the generated bytes are just exact
@@ -48,14 +77,30 @@ namespace tap
 		/// is generated.
 		static ByteArray serializeTapeStream(const ByteRange & bytes, bool is_header, bool is_tap_block = true);
 		
+		/// Works like `serializeTapeStream()`, but appends the generated bytes directly to |out| array.
+		/// Returns false if |bytes| cannot be serialized.
+		static bool appendTapeStream(ByteArray & out, const ByteRange & bytes, bool is_header, bool is_tap_block = true);
+		
+		/// Returns number of bytes generated by `serializeTapeStream()` for |bytes_count| bytes.
+		static size_t tapeStreamSize(size_t bytes_count, bool is_tap_block = true);
+		
+		/// Size of tape header, in bytes.
+		static const size_t HEADER_SIZE = 17;
+		
 		/// Generates 17 bytes header for given file entry.
 		static ByteArray serializeHeader(const FileEntry & file);
+		
+		/// Writes 17 bytes header for given file entry to |out| buffer.
+		static void serializeHeader(const FileEntry & file, byte (&out)[HEADER_SIZE]);
 
 	private:
 		
 		/// Reports error to logger
 		void reportError(const FileEntry & entry, FileEntry::ValidationResult result) const;
 		
+		/// Returns checksum of tape block with |leading_byte| and |bytes|.
+		static byte checksum(byte leading_byte, const ByteRange & bytes);
+		
 		/// Information about what's source of this TAP file.
 		SourceFileInfo _sourceFileInfo;
 		
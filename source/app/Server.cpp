@@ -0,0 +1,624 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Server.h"
+#include <bastapir/BastapirDocument.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+namespace bastapir
+{
+	// MARK: - JSON helpers
+	
+	/// The `JsonValue` structure contains one scalar value from request.
+	struct JsonValue
+	{
+		/// Value as it appears in the request, used to copy `id` to the reply.
+		std::string raw;
+		/// Unescaped content of string value, or raw text of other values.
+		std::string text;
+	};
+	
+	typedef std::map<std::string, JsonValue> JsonObject;
+	
+	/// Minimal reader of flat JSON objects, with string, number, boolean and null values.
+	class JsonReader
+	{
+	public:
+		JsonReader(std::string_view text) :
+			_text(text),
+			_pos(0)
+		{
+		}
+		
+		/// Reads whole object to |object|. Returns false and sets |error| if text is not valid.
+		bool readObject(JsonObject & object, std::string & error)
+		{
+			if (!consume('{')) {
+				error = "Request must be a JSON object.";
+				return false;
+			}
+			if (!consume('}')) {
+				while (true) {
+					JsonValue key, value;
+					if (!readString(key) || !consume(':') || !readValue(value)) {
+						error = "Invalid JSON object, or value is not a string, number, boolean or null.";
+						return false;
+					}
+					object[key.text] = value;
+					if (consume(',')) {
+						continue;
+					}
+					if (consume('}')) {
+						break;
+					}
+					error = "Expected `,` or `}` in JSON object.";
+					return false;
+				}
+			}
+			skipWhitespace();
+			if (_pos != _text.size()) {
+				error = "Unexpected characters after JSON object.";
+				return false;
+			}
+			return true;
+		}
+		
+	private:
+		
+		void skipWhitespace()
+		{
+			while (_pos < _text.size() && (_text[_pos] == ' ' || _text[_pos] == '\t' || _text[_pos] == '\r' || _text[_pos] == '\n')) {
+				_pos++;
+			}
+		}
+		
+		bool consume(char c)
+		{
+			skipWhitespace();
+			if (_pos < _text.size() && _text[_pos] == c) {
+				_pos++;
+				return true;
+			}
+			return false;
+		}
+		
+		bool readValue(JsonValue & value)
+		{
+			skipWhitespace();
+			if (_pos < _text.size() && _text[_pos] == '"') {
+				return readString(value);
+			}
+			// Number, boolean or null
+			const size_t begin = _pos;
+			while (_pos < _text.size() && (isalnum(_text[_pos]) || _text[_pos] == '-' || _text[_pos] == '+' || _text[_pos] == '.')) {
+				_pos++;
+			}
+			const auto token = _text.substr(begin, _pos - begin);
+			if (token != "true" && token != "false" && token != "null" && !isNumber(token)) {
+				return false;
+			}
+			value.raw = std::string(token);
+			value.text = value.raw;
+			return true;
+		}
+		
+		/// Returns true if |token| is a valid JSON number. The `from_chars()` also accepts forms
+		/// not allowed in JSON, like `.5`, `1.`, `01` or `inf`, so these are rejected first.
+		static bool isNumber(std::string_view token)
+		{
+			const size_t first = !token.empty() && token[0] == '-' ? 1 : 0;
+			if (first >= token.size() || !isdigit(token[first])) {
+				return false;
+			}
+			if (token[first] == '0' && first + 1 < token.size() && isdigit(token[first + 1])) {
+				return false;
+			}
+			const size_t dot = token.find('.');
+			if (dot != std::string_view::npos && (dot + 1 >= token.size() || !isdigit(token[dot + 1]))) {
+				return false;
+			}
+			double number;
+			const auto end = token.data() + token.size();
+			const auto result = std::from_chars(token.data(), end, number);
+			// Values out of range are still valid JSON numbers.
+			return (result.ec == std::errc() || result.ec == std::errc::result_out_of_range) && result.ptr == end;
+		}
+		
+		bool readString(JsonValue & value)
+		{
+			if (!consume('"')) {
+				return false;
+			}
+			const size_t begin = _pos - 1;
+			std::string & out = value.text;
+			while (_pos < _text.size()) {
+				char c = _text[_pos++];
+				if (c == '"') {
+					value.raw = std::string(_text.substr(begin, _pos - begin));
+					return true;
+				}
+				if (c != '\\') {
+					out += c;
+					continue;
+				}
+				if (_pos >= _text.size()) {
+					return false;
+				}
+				c = _text[_pos++];
+				switch (c) {
+					case '"': case '\\': case '/': out += c; break;
+					case 'b': out += '\b'; break;
+					case 'f': out += '\f'; break;
+					case 'n': out += '\n'; break;
+					case 'r': out += '\r'; break;
+					case 't': out += '\t'; break;
+					case 'u': {
+						U32 cp;
+						if (!readHex4(cp)) {
+							return false;
+						}
+						if (cp >= 0xD800 && cp <= 0xDBFF) {
+							// Surrogate pair
+							U32 low;
+							if (_pos + 2 > _text.size() || _text[_pos] != '\\' || _text[_pos + 1] != 'u') {
+								return false;
+							}
+							_pos += 2;
+							if (!readHex4(low) || low < 0xDC00 || low > 0xDFFF) {
+								return false;
+							}
+							cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						}
+						appendUtf8(out, cp);
+						break;
+					}
+					default:
+						return false;
+				}
+			}
+			return false;
+		}
+		
+		bool readHex4(U32 & value)
+		{
+			if (_pos + 4 > _text.size()) {
+				return false;
+			}
+			value = 0;
+			for (size_t i = 0; i < 4; i++) {
+				const char c = _text[_pos++];
+				value <<= 4;
+				if (c >= '0' && c <= '9') {
+					value |= c - '0';
+				} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+					value |= (c | 0x20) - 'a' + 10;
+				} else {
+					return false;
+				}
+			}
+			return true;
+		}
+		
+		static void appendUtf8(std::string & out, U32 cp)
+		{
+			if (cp < 0x80) {
+				out += (char)cp;
+			} else if (cp < 0x800) {
+				out += (char)(0xC0 | (cp >> 6));
+				out += (char)(0x80 | (cp & 0x3F));
+			} else if (cp < 0x10000) {
+				out += (char)(0xE0 | (cp >> 12));
+				out += (char)(0x80 | ((cp >> 6) & 0x3F));
+				out += (char)(0x80 | (cp & 0x3F));
+			} else {
+				out += (char)(0xF0 | (cp >> 18));
+				out += (char)(0x80 | ((cp >> 12) & 0x3F));
+				out += (char)(0x80 | ((cp >> 6) & 0x3F));
+				out += (char)(0x80 | (cp & 0x3F));
+			}
+		}
+		
+		std::string_view _text;
+		size_t _pos;
+	};
+	
+	/// Appends |str| to |out| as JSON string, including quotes.
+	static void AppendJsonString(std::string & out, std::string_view str)
+	{
+		static const char * hex = "0123456789abcdef";
+		out += '"';
+		for (char c: str) {
+			switch (c) {
+				case '"':  out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\n': out += "\\n"; break;
+				case '\r': out += "\\r"; break;
+				case '\t': out += "\\t"; break;
+				default:
+					if ((byte)c < 0x20) {
+						out += "\\u00";
+						out += hex[(byte)c >> 4];
+						out += hex[(byte)c & 0xF];
+					} else {
+						out += c;
+					}
+					break;
+			}
+		}
+		out += '"';
+	}
+	
+	/// Appends |bytes| to |out| encoded in Base64.
+	static void AppendBase64(std::string & out, const ByteRange & bytes)
+	{
+		static const char * alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		out.reserve(out.size() + (bytes.size() + 2) / 3 * 4);
+		size_t i = 0;
+		for (; i + 3 <= bytes.size(); i += 3) {
+			const U32 v = (bytes[i] << 16) | (bytes[i + 1] << 8) | bytes[i + 2];
+			out += alphabet[(v >> 18) & 0x3F];
+			out += alphabet[(v >> 12) & 0x3F];
+			out += alphabet[(v >> 6) & 0x3F];
+			out += alphabet[v & 0x3F];
+		}
+		if (i < bytes.size()) {
+			const bool two = i + 1 < bytes.size();
+			const U32 v = (bytes[i] << 16) | (two ? bytes[i + 1] << 8 : 0);
+			out += alphabet[(v >> 18) & 0x3F];
+			out += alphabet[(v >> 12) & 0x3F];
+			out += two ? alphabet[(v >> 6) & 0x3F] : '=';
+			out += '=';
+		}
+	}
+	
+	// MARK: - Session
+	
+	/// The `CompileSession` class processes requests from one client. The document, parser
+	/// and their buffers are kept between requests.
+	class CompileSession
+	{
+	public:
+		CompileSession(const BuildCache * cache) :
+			_document(&_log),
+			_parser(&_log),
+			_builder(&_log)
+		{
+			_document.setBuildCache(cache);
+			// Files are edited while the server is running, so they must not be mapped into memory.
+			_document.setFileLoading(SourceFile::ReadIntoBuffer);
+		}
+		
+		/// Processes one |request| line and returns reply line, without line end. Sets |shutdown|
+		/// to true if client requested shutdown of the server.
+		std::string process(std::string_view request, bool & shutdown)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			JsonObject object;
+			std::string error;
+			JsonReader reader(request);
+			if (!reader.readObject(object, error)) {
+				return errorReply("null", error);
+			}
+			const std::string id = object.count("id") ? object["id"].raw : "null";
+			const std::string command = object.count("command") ? object["command"].text : "compile";
+			if (command == "ping") {
+				return "{\"id\":" + id + ",\"result\":true}";
+			}
+			if (command == "shutdown") {
+				shutdown = true;
+				return "{\"id\":" + id + ",\"result\":true}";
+			}
+			if (command != "compile") {
+				return errorReply(id, "Unknown command `" + command + "`.");
+			}
+			
+			_log.clear();
+			_archive.clear();
+			_output = object.count("output") ? object["output"].text : std::string();
+			bool result;
+			if (object.count("document")) {
+				result = compileDocument(object["document"].text);
+			} else if (object.count("basic")) {
+				result = compileBasic(object);
+			} else {
+				return errorReply(id, "Request has no `document` or `basic` field.");
+			}
+			
+			// Compose reply
+			std::string reply = "{\"id\":" + id + ",\"result\":" + (result ? "true" : "false");
+			reply += ",\"time\":" + std::to_string(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+			if (result) {
+				if (!_output.empty()) {
+					reply += ",\"output\":";
+					AppendJsonString(reply, _output);
+					reply += ",\"size\":" + std::to_string(_archiveSize);
+				} else {
+					reply += ",\"size\":" + std::to_string(_archive.size()) + ",\"tap\":\"";
+					AppendBase64(reply, _archive.byteRange());
+					reply += '"';
+				}
+			}
+			reply += ",\"diagnostics\":[";
+			bool first = true;
+			for (auto && m: _log.messages()) {
+				static const char * severities[] = { "error", "warning", "info", "debug" };
+				reply += first ? "{\"severity\":\"" : ",{\"severity\":\"";
+				reply += severities[m.severity];
+				reply += "\",\"file\":";
+				AppendJsonString(reply, m.info.sourceFile);
+				reply += ",\"line\":" + std::to_string(m.info.line) + ",\"column\":" + std::to_string(m.info.column) + ",\"message\":";
+				AppendJsonString(reply, m.message);
+				reply += '}';
+				first = false;
+			}
+			reply += "]}";
+			return reply;
+		}
+		
+	private:
+		
+		static std::string errorReply(const std::string & id, const std::string & error)
+		{
+			std::string reply = "{\"id\":" + id + ",\"result\":false,\"error\":";
+			AppendJsonString(reply, error);
+			reply += '}';
+			return reply;
+		}
+		
+		bool compileDocument(const std::string & path)
+		{
+			auto file = SourceTextFile(Path(path), SourceFile::ReadIntoBuffer);
+			if (!file.isValid()) {
+				_log.error("Unable to open document: " + path);
+				return false;
+			}
+			if (!_document.parseDocument(file)) {
+				return false;
+			}
+			if (_output.empty() && _document.hasOutputFile()) {
+				_output = _document.outputFile();
+			}
+			return writeOutput([this](tap::ArchiveSink & sink) { return _document.writeArchive(sink); });
+		}
+		
+		bool compileBasic(JsonObject & object)
+		{
+			const auto name = object.count("name") ? object["name"].text : std::string("program");
+			const auto file = object.count("file") ? object["file"].text : std::string("<inline>");
+			auto dialect = bas::Keywords::Dialect_48K;
+			if (object.count("dialect")) {
+				const auto & value = object["dialect"].text;
+				if (value == "128k" || value == "128K") {
+					dialect = bas::Keywords::Dialect_128K;
+				} else if (value != "48k" && value != "48K") {
+					_log.error("Unknown BASIC dialect `" + value + "`.");
+					return false;
+				}
+			}
+			const auto info = SourceFileInfo { file, SourceFileInfo::Text };
+			if (!_parser.parse(object["basic"].text, info, dialect)) {
+				return false;
+			}
+			std::string autostart_var;
+			bool resolved;
+			std::tie(resolved, autostart_var) = _parser.resolveVariable("autostart");
+			long autostart_line = tap::FileEntry::Params::NO_AUTOSTART;
+			if (resolved) {
+				std::from_chars(autostart_var.data(), autostart_var.data() + autostart_var.size(), autostart_line);
+			}
+			auto entry_params = tap::FileEntry::Params();
+			entry_params.program.autostartLine = autostart_line;
+			entry_params.program.variableArea = _parser.programBytes().size();
+			
+			_builder.removeAllFiles();
+			_builder.setSourceFileInfo(info);
+			_builder.emplaceFile(name, tap::FileEntry::Program, _parser.releaseProgramBytes()).setParams(entry_params);
+			if (!_builder.validate()) {
+				return false;
+			}
+			return writeOutput([this](tap::ArchiveSink & sink) { return _builder.write(sink); });
+		}
+		
+		/// Writes archive produced by |write| function to output file, or to the reply buffer.
+		template <typename WriteFunc>
+		bool writeOutput(WriteFunc write)
+		{
+			if (_output.empty()) {
+				tap::ByteArraySink sink(_archive);
+				return write(sink);
+			}
+			int fd = open(_output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0) {
+				_log.error("Unable to open output file: " + _output);
+				return false;
+			}
+			tap::FileDescriptorSink sink(fd);
+			bool result = write(sink);
+			result = (close(fd) == 0) && result;
+			_archiveSize = sink.writtenBytes();
+			if (!result) {
+				_log.error("Unable to write output file: " + _output);
+			}
+			return result;
+		}
+		
+		BufferedErrorLogger _log;
+		BastapirDocument _document;
+		bas::BasicTextParser _parser;
+		tap::TapArchiveBuilder _builder;
+		std::string _output;
+		ByteArray _archive;
+		size_t _archiveSize = 0;
+	};
+	
+	// MARK: - Server
+	
+	CompileServer::CompileServer(const BuildCache * cache) :
+		_cache(cache),
+		_shutdown(false),
+		_runningConnections(0)
+	{
+	}
+	
+	void CompileServer::serveStream(FILE * input, FILE * output)
+	{
+		CompileSession session(_cache);
+		char * line = nullptr;
+		size_t capacity = 0;
+		ssize_t length;
+		while (!_shutdown && (length = getline(&line, &capacity, input)) >= 0) {
+			auto request = std::string_view(line, length);
+			while (!request.empty() && (request.back() == '\n' || request.back() == '\r')) {
+				request.remove_suffix(1);
+			}
+			if (request.empty()) {
+				continue;
+			}
+			bool shutdown = false;
+			auto reply = session.process(request, shutdown);
+			reply += '\n';
+			fwrite(reply.data(), 1, reply.size(), output);
+			fflush(output);
+			if (shutdown) {
+				this->shutdown();
+			}
+		}
+		free(line);
+	}
+	
+	bool CompileServer::serveSocket(const std::string & path)
+	{
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if (path.size() >= sizeof(address.sun_path)) {
+			fprintf(stderr, "Socket path is too long: %s\n", path.c_str());
+			return false;
+		}
+		memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		
+		// Remove socket left by the previous server, but never any other file.
+		struct stat st;
+		if (lstat(path.c_str(), &st) == 0) {
+			if (!S_ISSOCK(st.st_mode)) {
+				fprintf(stderr, "File at socket path exists and it's not a socket: %s\n", path.c_str());
+				return false;
+			}
+			unlink(path.c_str());
+		}
+		int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (listen_fd < 0) {
+			perror("socket");
+			return false;
+		}
+		if (bind(listen_fd, (sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, 16) < 0) {
+			perror("bind");
+			close(listen_fd);
+			return false;
+		}
+		// Client may disconnect before it reads the reply.
+		signal(SIGPIPE, SIG_IGN);
+		_socketPath = path;
+		
+		while (!_shutdown) {
+			int fd = accept(listen_fd, nullptr, nullptr);
+			if (fd < 0) {
+				if (errno == EINTR || errno == ECONNABORTED) {
+					continue;
+				}
+				perror("accept");
+				break;
+			}
+			if (_shutdown) {
+				close(fd);
+				break;
+			}
+			{
+				std::lock_guard<std::mutex> lock(_connectionsMutex);
+				_connections.push_back(fd);
+				_runningConnections++;
+			}
+			// The thread removes its connection when it's finished, so nothing has to join it.
+			std::thread(&CompileServer::serveConnection, this, fd).detach();
+		}
+		close(listen_fd);
+		unlink(path.c_str());
+		
+		// Wake up all connections waiting for requests and wait until they're closed.
+		std::unique_lock<std::mutex> lock(_connectionsMutex);
+		for (int fd: _connections) {
+			::shutdown(fd, SHUT_RD);
+		}
+		_connectionsClosed.wait(lock, [this] { return _runningConnections == 0; });
+		return true;
+	}
+	
+	// MARK: - Private
+	
+	void CompileServer::serveConnection(int fd)
+	{
+		FILE * input = fdopen(fd, "r");
+		FILE * output = fdopen(dup(fd), "w");
+		if (input && output) {
+			serveStream(input, output);
+		}
+		{
+			// Remove the socket before it's closed, so the server never shuts down
+			// a descriptor which reuses the same number.
+			std::lock_guard<std::mutex> lock(_connectionsMutex);
+			_connections.erase(std::find(_connections.begin(), _connections.end(), fd));
+		}
+		if (output) {
+			fclose(output);
+		}
+		if (input) {
+			fclose(input);
+		} else {
+			close(fd);
+		}
+		// The server may be destroyed as soon as the last connection is finished.
+		std::lock_guard<std::mutex> lock(_connectionsMutex);
+		_runningConnections--;
+		_connectionsClosed.notify_all();
+	}
+	
+	void CompileServer::shutdown()
+	{
+		if (_shutdown.exchange(true) || _socketPath.empty()) {
+			return;
+		}
+		// Wake up the accept loop with a new connection.
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		memcpy(address.sun_path, _socketPath.c_str(), _socketPath.size() + 1);
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0) {
+			connect(fd, (sockaddr*)&address, sizeof(address));
+			close(fd);
+		}
+	}
+	
+} // bastapir
@@ -0,0 +1,84 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#pragma once
+
+#include <bastapir/BuildCache.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+
+namespace bastapir
+{
+	/// The `CompileServer` class serves compile requests over a line-delimited JSON protocol.
+	/// Each request is one JSON object on a single line and each reply is also one line.
+	///
+	/// Request fields:
+	/// - `id` - any value, copied to the reply.
+	/// - `command` - `compile` (default), `ping` or `shutdown`.
+	/// - `document` - path to document to compile.
+	/// - `basic` - inline BASIC program to compile, instead of document.
+	/// - `name` - name of the inline program in the archive (default `program`).
+	/// - `file` - file name reported in diagnostics for the inline program.
+	/// - `dialect` - `48k` (default) or `128k` dialect for the inline program.
+	/// - `output` - path to output file. If not set, then document's `output` command is used.
+	///   If there's no output, then the archive is returned in the reply, encoded in Base64.
+	///
+	/// Reply fields are `id`, `result`, `time` (in milliseconds), `output` and `size`, or `tap`,
+	/// and `diagnostics`, which is an array of objects with `severity`, `file`, `line`, `column`
+	/// and `message`. If request can't be processed at all, then the reply contains `error`.
+	///
+	/// Relative paths are resolved against the working directory of the server.
+	class CompileServer
+	{
+	public:
+		
+		/// Constructs server compiling documents with optional build |cache|.
+		CompileServer(const BuildCache * cache = nullptr);
+		
+		/// Serves requests from |input| and writes replies to |output|, until end of input,
+		/// or until the server is shut down.
+		void serveStream(FILE * input, FILE * output);
+		
+		/// Listens on Unix domain socket at |path| and serves each connection on its own thread,
+		/// until the server is shut down. Returns false if socket can't be created.
+		bool serveSocket(const std::string & path);
+		
+	private:
+		
+		/// Serves requests from connected socket |fd|, then closes the socket.
+		void serveConnection(int fd);
+		
+		/// Stops serving requests.
+		void shutdown();
+		
+		const BuildCache * _cache;
+		std::atomic<bool> _shutdown;
+		std::string _socketPath;
+		std::mutex _connectionsMutex;
+		/// Sockets of connections waiting for requests. The socket is removed before it's closed,
+		/// so the number can't be reused by another descriptor while it's in the list.
+		std::vector<int> _connections;
+		/// Number of threads serving connections.
+		size_t _runningConnections;
+		/// Signalled when a thread serving connection is finished.
+		std::condition_variable _connectionsClosed;
+	};
+	
+} // bastapir
@@ -0,0 +1,181 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Watcher.h"
+#include <bastapir/common/Path.h>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <poll.h>
+#include <errno.h>
+#if defined(__linux__)
+#include <sys/inotify.h>
+#endif
+
+namespace bastapir
+{
+	/// Interval between checks of files, when inotify is not available.
+	static const auto POLL_INTERVAL = std::chrono::milliseconds(250);
+	
+	/// Maximum time between checks of files with inotify. The check finds changes of
+	/// files in directories which couldn't be watched, for example because they don't exist yet.
+	static const int NOTIFY_TIMEOUT_MS = 1000;
+	
+	/// Time given to other processes to finish writing, after the first change is noticed.
+	/// Editors often save a file in several steps.
+	static const auto SETTLE_TIME = std::chrono::milliseconds(30);
+	
+	// MARK: - Class implementation
+	
+	FileWatcher::FileWatcher() :
+		_notifyFd(-1)
+	{
+#if defined(__linux__)
+		_notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	}
+	
+	FileWatcher::~FileWatcher()
+	{
+		if (_notifyFd >= 0) {
+			close(_notifyFd);
+		}
+	}
+	
+	void FileWatcher::setFiles(const std::vector<std::string> & files)
+	{
+		_files.clear();
+		for (auto && path: files) {
+			_files[path] = fileState(path);
+		}
+		updateWatches();
+	}
+	
+	bool FileWatcher::usesNotifications() const
+	{
+		return _notifyFd >= 0;
+	}
+	
+	bool FileWatcher::waitForChange(std::vector<std::string> & changed, std::chrono::steady_clock::time_point & noticed)
+	{
+		changed.clear();
+		while (changed.empty()) {
+			if (!waitForEvent()) {
+				return false;
+			}
+			noticed = std::chrono::steady_clock::now();
+			for (auto && file: _files) {
+				if (!(fileState(file.first) == file.second)) {
+					changed.push_back(file.first);
+				}
+			}
+			if (changed.empty()) {
+				continue;
+			}
+			// Let the writer finish and take the final state of all files.
+			std::this_thread::sleep_for(SETTLE_TIME);
+			drainEvents();
+			changed.clear();
+			for (auto && file: _files) {
+				auto state = fileState(file.first);
+				if (!(state == file.second)) {
+					file.second = state;
+					changed.push_back(file.first);
+				}
+			}
+		}
+		return true;
+	}
+	
+	// MARK: - Private
+	
+	FileWatcher::FileState FileWatcher::fileState(const std::string & path)
+	{
+		FileState state;
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0) {
+			state.exists = true;
+			state.size = st.st_size;
+			state.inode = st.st_ino;
+#if defined(__APPLE__)
+			state.modificationTime = U64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+			state.modificationTime = U64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+		}
+		return state;
+	}
+	
+	bool FileWatcher::waitForEvent()
+	{
+		if (_notifyFd < 0) {
+			std::this_thread::sleep_for(POLL_INTERVAL);
+			return true;
+		}
+#if defined(__linux__)
+		pollfd fds = { _notifyFd, POLLIN, 0 };
+		int result = poll(&fds, 1, NOTIFY_TIMEOUT_MS);
+		if (result < 0 && errno != EINTR) {
+			return false;
+		}
+		drainEvents();
+#endif
+		return true;
+	}
+	
+	void FileWatcher::drainEvents()
+	{
+#if defined(__linux__)
+		if (_notifyFd < 0) {
+			return;
+		}
+		// The events are not examined, because all files are compared with their
+		// last known state anyway.
+		alignas(inotify_event) char buffer[4096];
+		while (read(_notifyFd, buffer, sizeof(buffer)) > 0) {
+		}
+#endif
+	}
+	
+	void FileWatcher::updateWatches()
+	{
+#if defined(__linux__)
+		if (_notifyFd < 0) {
+			return;
+		}
+		for (auto && watch: _watches) {
+			inotify_rm_watch(_notifyFd, watch.second);
+		}
+		_watches.clear();
+		for (auto && file: _files) {
+			auto directory = Path::components(file.first).directory;
+			if (directory.empty()) {
+				directory = ".";
+			}
+			if (_watches.count(directory)) {
+				continue;
+			}
+			// Editors often replace the file with a new one, so the whole directory is watched.
+			const U32 mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB;
+			int wd = inotify_add_watch(_notifyFd, directory.c_str(), mask);
+			if (wd >= 0) {
+				_watches[directory] = wd;
+			}
+		}
+#endif
+	}
+	
+} // bastapir
@@ -0,0 +1,86 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+#include <chrono>
+#include <map>
+
+namespace bastapir
+{
+	/// The `FileWatcher` class waits until some of watched files is changed. On Linux, the
+	/// watcher is notified by inotify about changes in directories containing the files.
+	/// On other systems, or if inotify is not available, the files are polled periodically.
+	/// In both cases, the file is reported as changed only if its size, modification time,
+	/// or identity is different, so it's not reported when it's just opened for writing.
+	class FileWatcher
+	{
+	public:
+		
+		FileWatcher();
+		~FileWatcher();
+		
+		FileWatcher(const FileWatcher &) = delete;
+		FileWatcher & operator=(const FileWatcher &) = delete;
+		
+		/// Sets |files| to watch. The current state of files is used to detect following changes.
+		void setFiles(const std::vector<std::string> & files);
+		
+		/// Blocks until some of watched files is changed. Paths of changed files are stored
+		/// to |changed| and time when the first change was noticed is stored to |noticed|.
+		/// Returns false if the watcher can't wait for changes.
+		bool waitForChange(std::vector<std::string> & changed, std::chrono::steady_clock::time_point & noticed);
+		
+		/// Returns true if changes are detected with inotify, false if files are polled.
+		bool usesNotifications() const;
+		
+	private:
+		
+		/// The `FileState` structure contains information used to detect change of file.
+		struct FileState
+		{
+			bool exists = false;
+			U64 size = 0;
+			U64 modificationTime = 0;
+			U64 inode = 0;
+			
+			bool operator==(const FileState & other) const {
+				return exists == other.exists && size == other.size && modificationTime == other.modificationTime && inode == other.inode;
+			}
+		};
+		
+		/// Returns current state of file at |path|.
+		static FileState fileState(const std::string & path);
+		
+		/// Blocks until a notification, or polling interval elapses.
+		bool waitForEvent();
+		
+		/// Removes all pending notifications, without blocking.
+		void drainEvents();
+		
+		/// Updates watches for directories containing watched files.
+		void updateWatches();
+		
+		/// Watched files and their last known state.
+		std::map<std::string, FileState> _files;
+		/// inotify descriptor, or -1 if files are polled.
+		int _notifyFd;
+		/// Watch descriptors for watched directories.
+		std::map<std::string, int> _watches;
+	};
+	
+} // bastapir
@@ -14,30 +14,353 @@
 // limitations under the License.
 //
 
+#include "Server.h"
+#include "Watcher.h"
 #include <bastapir/common/Path.h>
 #include <bastapir/BastapirDocument.h>
 #include <bastapir/bas/Keywords.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
 
 using namespace bastapir;
 using namespace bastapir::tap;
 
+typedef std::chrono::steady_clock Clock;
+
+static void PrintUsage(const char * program)
+{
+	printf("Usage: %s [options] document [output.tap]\n", program);
+	printf("       %s [options] --batch [document ...] [@list] [-]\n", program);
+	printf("       %s --server | --socket PATH\n", program);
+	printf("Options:\n");
+	printf("  -j, --jobs N      Number of threads compiling files, or documents in batch mode (default: number of CPU cores)\n");
+	printf("  --batch           Compile all documents from arguments. Each @list argument is a file with one\n");
+	printf("                    document per line and - reads such list from standard input. Without any document,\n");
+	printf("                    the list is read from standard input. Document without `output` command is written\n");
+	printf("                    next to the document, with .tap extension.\n");
+	printf("  --depfile         Write Make-style dependency file next to each output file, with .d suffix.\n");
+	printf("  --watch           Compile document again whenever the document, or any file used by it, is changed.\n");
+	printf("                    Only changed BASIC programs are compiled again and output is replaced atomically.\n");
+	printf("  --cache DIR       Keep compiled BASIC programs in DIR, so unchanged programs are not compiled again.\n");
+	printf("  --server          Serve compile requests, one JSON object per line, on standard input and output.\n");
+	printf("  --socket PATH     Serve compile requests on Unix domain socket at PATH.\n");
+}
+
+/// Returns elapsed time since |start| in milliseconds.
+static double ElapsedMs(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// MARK: - Compilation
+
+/// The `OutputOptions` structure contains options for writing the output file.
+struct OutputOptions
+{
+	/// Write dependency file next to the output file.
+	bool depfile = false;
+	/// Write output to a temporary file, which then replaces the output file, so readers
+	/// never see an incomplete archive.
+	bool atomic = false;
+};
+
+/// Appends |path| to |out| with characters special for Make and Ninja escaped.
+static void AppendDependencyPath(std::string & out, const std::string & path)
+{
+	for (char c: path) {
+		if (c == ' ' || c == '#') {
+			out += '\\';
+		} else if (c == '$') {
+			out += '$';
+		}
+		out += c;
+	}
+}
+
+/// Writes Make-style dependency file for |output_path| compiled from document at |path|.
+/// The file is written to |output_path| with `.d` suffix. Returns true on success.
+static bool WriteDependencyFile(const BastapirDocument & doc, const std::string & path, const std::string & output_path)
+{
+	std::string content;
+	AppendDependencyPath(content, output_path);
+	content += ": ";
+	AppendDependencyPath(content, path);
+	for (auto && dependency: doc.dependencies()) {
+		content += " \\\n  ";
+		AppendDependencyPath(content, dependency);
+	}
+	content += "\n";
+	std::ofstream file(output_path + ".d", std::ios::binary | std::ios::trunc);
+	file << content;
+	file.close();
+	return !file.fail();
+}
+
+/// Compiles document at |path| with |doc| object and streams the archive to the output file.
+/// If document has no `output` command, then |default_output| is used. Returns true on success.
+static bool CompileDocument(BastapirDocument & doc, const std::string & path, const char * default_output, const OutputOptions & options)
+{
+	auto file = SourceTextFile(Path(path), doc.fileLoading());
+	if (!doc.parseDocument(file)) {
+		return false;
+	}
+	// Stream the archive directly to the output file.
+	const char * output_path = doc.hasOutputFile() ? doc.outputFile().c_str() : default_output;
+	if (!output_path) {
+		return false;
+	}
+	const std::string write_path = options.atomic ? std::string(output_path) + ".tmp." + std::to_string(getpid()) : output_path;
+	int fd = open(write_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	FileDescriptorSink sink(fd);
+	bool result = doc.writeArchive(sink);
+	result = (close(fd) == 0) && result;
+	if (options.atomic) {
+		result = result && rename(write_path.c_str(), output_path) == 0;
+		if (!result) {
+			unlink(write_path.c_str());
+		}
+	}
+	if (result && options.depfile) {
+		result = WriteDependencyFile(doc, path, output_path);
+	}
+	return result;
+}
+
+// MARK: - Batch mode
+
+/// Appends documents listed in |stream|, one per line, to |documents|. Empty lines and lines
+/// starting with `#` are ignored.
+static void ReadDocumentList(std::istream & stream, std::vector<std::string> & documents)
+{
+	std::string line;
+	while (std::getline(stream, line)) {
+		const auto first = line.find_first_not_of(" \t\r");
+		if (first == std::string::npos || line[first] == '#') {
+			continue;
+		}
+		const auto last = line.find_last_not_of(" \t\r");
+		documents.push_back(line.substr(first, last - first + 1));
+	}
+}
+
+/// Compiles all |documents| on |pool|. Messages are reported to |logger| in order of documents,
+/// followed by aggregate timing. Returns true if all documents were compiled.
+static bool CompileBatch(const std::vector<std::string> & documents, ThreadPool & pool, const BuildCache * cache, const OutputOptions & options, ErrorLogging & logger)
+{
+	// Each thread takes a worker with document object, so the object and its buffers are
+	// reused for the following documents.
+	struct Worker
+	{
+		BufferedErrorLogger log;
+		BastapirDocument doc { &log };
+	};
+	struct Result
+	{
+		BufferedErrorLogger log;
+		bool result = false;
+		double time = 0.0;
+	};
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::mutex workers_mutex;
+	std::vector<Result> results(documents.size());
+	
+	const auto batch_start = Clock::now();
+	pool.run(documents.size(), [&](size_t index) {
+		std::unique_ptr<Worker> worker;
+		{
+			std::lock_guard<std::mutex> lock(workers_mutex);
+			if (!workers.empty()) {
+				worker = std::move(workers.back());
+				workers.pop_back();
+			}
+		}
+		if (!worker) {
+			worker = std::make_unique<Worker>();
+			worker->doc.setBuildCache(cache);
+		}
+		const auto start = Clock::now();
+		auto & path = documents[index];
+		auto components = Path::components(path);
+		auto default_output = (components.directory.empty() ? "" : components.directory + Path::directorySeparator) + components.fileNameNoExt + ".tap";
+		auto & result = results[index];
+		result.result = CompileDocument(worker->doc, path, default_output.c_str(), options);
+		result.time = ElapsedMs(start);
+		worker->log.flush(&result.log);
+		
+		std::lock_guard<std::mutex> lock(workers_mutex);
+		workers.push_back(std::move(worker));
+	});
+	const double wall_time = ElapsedMs(batch_start);
+	
+	// Report results in order of documents.
+	size_t failed = 0;
+	double total_time = 0.0;
+	double max_time = 0.0;
+	for (size_t i = 0; i < documents.size(); i++) {
+		auto & result = results[i];
+		result.log.flush(&logger);
+		if (!result.result) {
+			logger.error("Failed to compile document: " + documents[i]);
+			failed++;
+		}
+		total_time += result.time;
+		max_time = std::max(max_time, result.time);
+	}
+	printf("Batch: %zu documents, %zu failed, %zu threads\n", documents.size(), failed, pool.threadsCount());
+	printf("Time: %.2f ms wall, %.2f ms compile, %.3f ms average, %.3f ms maximum per document\n",
+		   wall_time, total_time, documents.empty() ? 0.0 : total_time / documents.size(), max_time);
+	return failed == 0;
+}
+
+// MARK: - Watch mode
+
+/// Compiles document at |path| and then compiles it again whenever the document, or any
+/// file used by the document is changed. The function returns only if files can't be watched.
+static bool WatchDocument(BastapirDocument & doc, const std::string & path, const char * default_output, const OutputOptions & options)
+{
+	FileWatcher watcher;
+	printf("Watching: %s (%s)\n", path.c_str(), watcher.usesNotifications() ? "inotify" : "polling");
+	fflush(stdout);
+	std::vector<std::string> changed;
+	auto noticed = Clock::now();
+	while (true) {
+		const auto start = Clock::now();
+		const bool result = CompileDocument(doc, path, default_output, options);
+		const double compile_time = ElapsedMs(start);
+		if (changed.empty()) {
+			printf("Build: %s, %.2f ms\n", result ? "sukcez" : "failure", compile_time);
+		} else {
+			printf("Rebuild: %s, %.2f ms compile, %.2f ms since change\n", result ? "sukcez" : "failure", compile_time, ElapsedMs(noticed));
+		}
+		fflush(stdout);
+		
+		// Files used by the document may differ after each change.
+		auto files = doc.dependencies();
+		files.insert(files.begin(), path);
+		watcher.setFiles(files);
+		if (!watcher.waitForChange(changed, noticed)) {
+			return false;
+		}
+		for (auto && file: changed) {
+			printf("Changed: %s\n", file.c_str());
+		}
+		fflush(stdout);
+	}
+}
+
+// MARK: - Main
+
 int main(int argc, const char * argv[])
 {
+	size_t jobs = 0;
+	bool batch = false;
+	bool server = false;
+	bool watch = false;
+	OutputOptions output_options;
+	std::string socket_path;
+	std::string cache_path;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if ((arg == "--jobs" || arg == "-j") && has_value) {
+			std::string value = argv[++i];
+			auto res = std::from_chars(value.data(), value.data() + value.size(), jobs);
+			if (res.ec != std::errc() || res.ptr != value.data() + value.size() || jobs == 0) {
+				fprintf(stderr, "Invalid number of jobs: %s\n", value.c_str());
+				return 1;
+			}
+		} else if (arg == "--cache" && has_value) {
+			cache_path = argv[++i];
+		} else if (arg == "--batch") {
+			batch = true;
+		} else if (arg == "--depfile") {
+			output_options.depfile = true;
+		} else if (arg == "--watch") {
+			watch = true;
+		} else if (arg == "--server") {
+			server = true;
+		} else if (arg == "--socket" && has_value) {
+			socket_path = argv[++i];
+		} else if (arg.size() > 1 && arg[0] == '-') {
+			PrintUsage(argv[0]);
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		} else {
+			paths.push_back(arg);
+		}
+	}
+	
+	std::unique_ptr<BuildCache> cache;
+	if (!cache_path.empty()) {
+		cache = std::make_unique<BuildCache>(cache_path);
+	}
+	
+	if (server || !socket_path.empty()) {
+		CompileServer compile_server(cache.get());
+		if (!socket_path.empty()) {
+			return compile_server.serveSocket(socket_path) ? 0 : 1;
+		}
+		compile_server.serveStream(stdin, stdout);
+		return 0;
+	}
+	
 	FileErrorLogger logger;
+	ThreadPool pool(jobs);
+	
+	if (batch) {
+		std::vector<std::string> documents;
+		bool read_stdin = paths.empty();
+		for (auto && path: paths) {
+			if (path == "-") {
+				read_stdin = true;
+			} else if (path[0] == '@') {
+				std::ifstream list(path.substr(1));
+				if (!list) {
+					logger.error("Unable to open list of documents: " + path.substr(1));
+					return 1;
+				}
+				ReadDocumentList(list, documents);
+			} else {
+				documents.push_back(path);
+			}
+		}
+		if (read_stdin) {
+			ReadDocumentList(std::cin, documents);
+		}
+		auto result = CompileBatch(documents, pool, cache.get(), output_options, logger);
+		printf("Result: %s\n", result ? "sukcez" : "failure");
+		return result ? 0 : 1;
+	}
+	
+	if (paths.empty() || paths.size() > 2) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	const char * default_output = paths.size() > 1 ? paths[1].c_str() : nullptr;
 	BastapirDocument doc(&logger);
-	auto path = Path(argv[1]);
-	auto file = SourceTextFile(path);
-	auto result = doc.processDocument(file);
-	if (result) {
-		auto bytes = doc.archiveBytes();
-		FILE * f = fopen(doc.hasOutputFile() ? doc.outputFile().c_str() : argv[2], "wb");
-		if (f) {
-			fwrite(bytes.data(), 1, bytes.size(), f);
-			fclose(f);
-		} else {
-			result = false;
+	if (pool.threadsCount() > 1) {
+		doc.setThreadPool(&pool);
+	}
+	if (watch) {
+		// Unchanged programs are kept at least in memory.
+		if (!cache) {
+			cache = std::make_unique<BuildCache>();
 		}
+		doc.setBuildCache(cache.get());
+		// Files are edited while the tool is running, so they must not be mapped into memory.
+		doc.setFileLoading(SourceFile::ReadIntoBuffer);
+		output_options.atomic = true;
+		return WatchDocument(doc, paths[0], default_output, output_options) ? 0 : 1;
 	}
+	doc.setBuildCache(cache.get());
+	auto result = CompileDocument(doc, paths[0], default_output, output_options);
 	printf("Result: %s\n", result ? "sukcez" : "failure");
 	return result ? 0 : 1;
 }
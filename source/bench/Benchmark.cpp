@@ -0,0 +1,129 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Benchmark.h"
+#include <chrono>
+#include <stdio.h>
+
+namespace bastapir
+{
+namespace bench
+{
+	// MARK: - Measurement
+
+	double Measurement::microsecondsPerIteration() const
+	{
+		return iterations > 0 ? (seconds * 1e6) / iterations : 0.0;
+	}
+
+	double Measurement::linesPerSecond() const
+	{
+		return seconds > 0.0 ? (double)(lines * iterations) / seconds : 0.0;
+	}
+
+	double Measurement::megabytesPerSecond() const
+	{
+		return seconds > 0.0 ? (double)(bytes * iterations) / (seconds * 1024.0 * 1024.0) : 0.0;
+	}
+
+
+	// MARK: - Benchmark
+
+	Benchmark::Benchmark(double min_time, size_t min_iterations) :
+		_minTime(min_time),
+		_minIterations(min_iterations)
+	{
+	}
+
+	void Benchmark::setFilter(const std::string & filter)
+	{
+		_filter = filter;
+	}
+
+	bool Benchmark::isEnabled(const std::string & name) const
+	{
+		return _filter.empty() || name.find(_filter) != std::string::npos;
+	}
+
+	bool Benchmark::measure(const std::string & name, size_t lines, size_t bytes, const std::function<bool()> & block)
+	{
+		if (!isEnabled(name)) {
+			return false;
+		}
+		// Warm up caches and validate that block works at all.
+		if (!block()) {
+			fprintf(stderr, "bench: stage `%s` failed.\n", name.c_str());
+			return false;
+		}
+		typedef std::chrono::steady_clock clock;
+
+		Measurement m;
+		m.name = name;
+		m.lines = lines;
+		m.bytes = bytes;
+
+		auto start = clock::now();
+		while (true) {
+			if (!block()) {
+				fprintf(stderr, "bench: stage `%s` failed during measurement.\n", name.c_str());
+				return false;
+			}
+			m.iterations++;
+			m.seconds = std::chrono::duration<double>(clock::now() - start).count();
+			if (m.iterations >= _minIterations && m.seconds >= _minTime) {
+				break;
+			}
+		}
+		_results.push_back(m);
+		printMeasurement(stdout, m);
+		return true;
+	}
+
+	const std::vector<Measurement> & Benchmark::results() const
+	{
+		return _results;
+	}
+
+	void Benchmark::printHeader(FILE * out) const
+	{
+		fprintf(out, "%-44s %10s %10s %12s %14s %10s\n", "stage", "iters", "lines", "us/iter", "lines/sec", "MB/sec");
+	}
+
+	void Benchmark::printMeasurement(FILE * out, const Measurement & m) const
+	{
+		fprintf(out, "%-44s %10zu %10zu %12.2f %14.0f %10.2f\n",
+				m.name.c_str(), m.iterations, m.lines,
+				m.microsecondsPerIteration(), m.linesPerSecond(), m.megabytesPerSecond());
+		fflush(out);
+	}
+
+
+	// MARK: - Helpers
+
+	size_t CountLines(std::string_view text)
+	{
+		if (text.empty()) {
+			return 0;
+		}
+		size_t count = std::count(text.begin(), text.end(), '\n');
+		if (text.back() != '\n') {
+			count++;
+		}
+		return count;
+	}
+
+} // bastapir::bench
+} // bastapir
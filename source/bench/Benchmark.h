@@ -0,0 +1,92 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+#include <functional>
+
+namespace bastapir
+{
+namespace bench
+{
+	/// The `Measurement` structure contains result of one measured stage.
+	struct Measurement
+	{
+		/// Name of measured stage, for example "parse simple.bas"
+		std::string name;
+		/// Number of measured iterations.
+		size_t iterations = 0;
+		/// Number of source lines processed in one iteration.
+		size_t lines = 0;
+		/// Number of bytes processed in one iteration.
+		size_t bytes = 0;
+		/// Total time spent in all iterations, in seconds.
+		double seconds = 0.0;
+
+		/// Returns average time of one iteration, in microseconds.
+		double microsecondsPerIteration() const;
+		/// Returns processed lines per second.
+		double linesPerSecond() const;
+		/// Returns processed megabytes per second.
+		double megabytesPerSecond() const;
+	};
+
+	/// The `Benchmark` class repeatedly executes measured blocks and collects
+	/// their throughput.
+	class Benchmark
+	{
+	public:
+
+		/// Constructs Benchmark object. Each measured block is executed at least
+		/// |min_iterations| times and for at least |min_time| seconds.
+		Benchmark(double min_time = 0.5, size_t min_iterations = 3);
+
+		/// Sets filter applied to measured stages. If filter is not empty, then only
+		/// stages containing the filter string in their name are measured.
+		void setFilter(const std::string & filter);
+
+		/// Returns true if stage with given |name| passes the filter.
+		bool isEnabled(const std::string & name) const;
+
+		/// Measures |block| for stage with given |name|. The |lines| and |bytes| parameters
+		/// define amount of data processed in one iteration. The block must return true
+		/// on success. Returns false if block failed or stage was filtered out.
+		bool measure(const std::string & name, size_t lines, size_t bytes, const std::function<bool()> & block);
+
+		/// Returns all collected measurements.
+		const std::vector<Measurement> & results() const;
+
+		/// Prints header of report table to |out| stream.
+		void printHeader(FILE * out) const;
+
+		/// Prints one measurement to |out| stream.
+		void printMeasurement(FILE * out, const Measurement & m) const;
+
+	private:
+
+		double _minTime;
+		size_t _minIterations;
+		std::string _filter;
+		std::vector<Measurement> _results;
+	};
+
+	/// Returns number of lines in given |text|. The last line doesn't need to be terminated
+	/// with the line end character.
+	size_t CountLines(std::string_view text);
+
+} // bastapir::bench
+} // bastapir
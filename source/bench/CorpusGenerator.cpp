@@ -0,0 +1,251 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "CorpusGenerator.h"
+#include <stdio.h>
+
+namespace bastapir
+{
+namespace bench
+{
+	// MARK: - Statement kinds
+
+	enum StatementKind
+	{
+		Kind_Keywords,
+		Kind_Numbers,
+		Kind_Labels,
+		Kind_Escapes,
+		Kind_Rems,
+		Kind_Continuations,
+		Kind_Count
+	};
+
+	// Escape sequences used in strings & REM statements.
+	static const char * s_escapes[] =
+	{
+		"\\  ", "\\ '", "\\' ", "\\''", "\\ .", "\\ :", "\\'.", "\\':",
+		"\\. ", "\\.'", "\\: ", "\\:'", "\\..", "\\.:", "\\:.", "\\::",
+		"\\a", "\\g", "\\m", "\\u", "\\*", "\\`", "\\\\", "\\@"
+	};
+	static const size_t s_escapesCount = sizeof(s_escapes) / sizeof(s_escapes[0]);
+
+	// Words used in generated strings & comments.
+	static const char * s_words[] =
+	{
+		"hello", "world", "score", "lives", "level", "press", "any", "key", "game", "over"
+	};
+	static const size_t s_wordsCount = sizeof(s_words) / sizeof(s_words[0]);
+
+
+	// MARK: - Class implementation
+
+	CorpusGenerator::CorpusGenerator(const Options & options) :
+		_options(options),
+		_state(options.seed != 0 ? options.seed : 0x5EED)
+	{
+	}
+
+	const CorpusGenerator::Options & CorpusGenerator::options() const
+	{
+		return _options;
+	}
+
+	std::string CorpusGenerator::program()
+	{
+		const Mix & mix = _options.mix;
+		const unsigned weights[Kind_Count] = {
+			mix.keywords, mix.numbers, mix.labels, mix.escapes, mix.rems, mix.continuations
+		};
+		unsigned total_weight = 0;
+		for (auto w: weights) {
+			total_weight += w;
+		}
+		if (total_weight == 0) {
+			return std::string();
+		}
+		const size_t per_label = std::max(_options.linesPerLabel, (size_t)1);
+		const size_t labels_count = mix.labels > 0 ? (_options.lines + per_label - 1) / per_label : 0;
+
+		std::string out;
+		out.reserve(_options.lines * 40);
+		out += "# Generated by bastap_bench, seed " + std::to_string(_options.seed) + "\n";
+
+		for (size_t line = 0; line < _options.lines; line++) {
+			if (labels_count > 0 && (line % per_label) == 0) {
+				out += "@label" + std::to_string(line / per_label) + ":\n";
+			}
+			out += '\t';
+			size_t statements = 1 + nextBelow(3);
+			for (size_t s = 0; s < statements; s++) {
+				// Pick statement kind by its weight.
+				U32 pick = nextBelow(total_weight);
+				unsigned kind = 0;
+				while (pick >= weights[kind]) {
+					pick -= weights[kind++];
+				}
+				if (s > 0) {
+					if (kind == Kind_Rems) {
+						// REM consumes rest of the line, so it cannot be followed by next statement.
+						break;
+					}
+					out += ": ";
+				}
+				appendStatement(out, kind, labels_count);
+				if (kind == Kind_Rems) {
+					break;
+				}
+			}
+			out += '\n';
+		}
+		return out;
+	}
+
+	ByteArray CorpusGenerator::codeBlock(size_t size)
+	{
+		ByteArray out;
+		out.reserve(size);
+		while (out.size() < size) {
+			out.push_back(next() & 0xFF);
+		}
+		return out;
+	}
+
+	bool CorpusGenerator::writeDocument(const std::string & directory, const std::string & name, size_t programs, size_t code_blocks)
+	{
+		bool result = true;
+		std::string document = "# Generated by bastap_bench\n\n";
+		for (size_t i = 0; i < programs; i++) {
+			auto file_name = name + "-" + std::to_string(i) + ".bas";
+			result = result && writeFile(directory + "/" + file_name, MakeRange(program()));
+			document += "basic \"" + file_name + "\" \"p" + std::to_string(i) + "\"\n";
+		}
+		for (size_t i = 0; i < code_blocks; i++) {
+			auto file_name = name + "-" + std::to_string(i) + ".bin";
+			result = result && writeFile(directory + "/" + file_name, codeBlock(6912));
+			document += "code \"" + file_name + "\" 0x4000 \"c" + std::to_string(i) + "\"\n";
+		}
+		document += "output \"" + name + ".tap\"\n";
+		result = result && writeFile(directory + "/" + name + ".bastap", MakeRange(document));
+		return result;
+	}
+
+	bool CorpusGenerator::writeFile(const std::string & path, const ByteRange & content)
+	{
+		FILE * f = fopen(path.c_str(), "wb");
+		if (!f) {
+			return false;
+		}
+		bool result = fwrite(content.data(), 1, content.size(), f) == content.size();
+		result = (fclose(f) == 0) && result;
+		return result;
+	}
+
+
+	// MARK: - Private
+
+	U32 CorpusGenerator::next()
+	{
+		// xorshift32, the same sequence on all platforms.
+		U32 x = _state;
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		_state = x;
+		return x;
+	}
+
+	U32 CorpusGenerator::nextBelow(U32 n)
+	{
+		return n > 0 ? next() % n : 0;
+	}
+
+	std::string CorpusGenerator::number(U32 n)
+	{
+		return std::to_string(nextBelow(n));
+	}
+
+	void CorpusGenerator::appendStatement(std::string & out, unsigned kind, size_t labels_count)
+	{
+		switch (kind) {
+			case Kind_Keywords:
+				switch (nextBelow(6)) {
+					case 0: out += "border " + number(8) + ": paper " + number(8) + ": ink " + number(8); break;
+					case 1: out += "print at " + number(22) + "," + number(32) + ";\"" + s_words[nextBelow(s_wordsCount)] + "\""; break;
+					case 2: out += "for f=0 to " + number(256) + ": next f"; break;
+					case 3: out += "if a>" + number(100) + " then let b=b+1"; break;
+					case 4: out += "plot " + number(256) + "," + number(176) + ": draw " + number(64) + ",-" + number(64); break;
+					default: out += "randomize usr " + number(65536); break;
+				}
+				break;
+
+			case Kind_Numbers:
+				switch (nextBelow(3)) {
+					case 0: {
+						char hex[8];
+						snprintf(hex, sizeof(hex), "0x%X", (unsigned)nextBelow(0x10000));
+						out += "data " + number(65536) + "," + number(100) + "." + number(1000) + "," + number(10) + "e" + number(5) + "," + hex;
+						break;
+					}
+					case 1: out += "let x=" + number(1000) + "." + number(100) + "*" + number(256) + "+." + number(100); break;
+					default: out += "poke " + std::to_string(23296 + nextBelow(256)) + ",bin " + (next() & 1 ? "10101010" : "01010101"); break;
+				}
+				break;
+
+			case Kind_Labels:
+				if (labels_count > 0) {
+					static const char * s_jumps[] = { "gosub", "goto", "restore", "run" };
+					out += std::string(s_jumps[nextBelow(4)]) + " @label" + std::to_string(nextBelow((U32)labels_count));
+				} else {
+					out += "stop";
+				}
+				break;
+
+			case Kind_Escapes: {
+				out += "print \"";
+				size_t count = 1 + nextBelow(8);
+				for (size_t i = 0; i < count; i++) {
+					out += s_escapes[nextBelow(s_escapesCount)];
+				}
+				out += s_words[nextBelow(s_wordsCount)];
+				out += "\"";
+				break;
+			}
+
+			case Kind_Rems:
+				out += "rem ";
+				out += s_words[nextBelow(s_wordsCount)];
+				out += " ";
+				out += s_escapes[nextBelow(s_escapesCount)];
+				out += " ";
+				out += s_words[nextBelow(s_wordsCount)];
+				break;
+
+			case Kind_Continuations:
+				out += "print \"";
+				out += s_words[nextBelow(s_wordsCount)];
+				out += "\";\\\n\t\t\"";
+				out += s_words[nextBelow(s_wordsCount)];
+				out += "\"";
+				break;
+
+			default:
+				break;
+		}
+	}
+
+} // bastapir::bench
+} // bastapir
@@ -0,0 +1,102 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/ByteArray.h>
+
+namespace bastapir
+{
+namespace bench
+{
+	/// The `CorpusGenerator` class generates synthetic BASIC programs and bastap documents.
+	/// The generated content depends only on provided options, so the same seed always
+	/// produces exactly the same corpus, on all platforms.
+	class CorpusGenerator
+	{
+	public:
+
+		/// The `Mix` structure defines relative weights of generated statement kinds.
+		/// Setting weight to 0 disables that kind of statement.
+		struct Mix
+		{
+			/// Keyword-heavy statements, like `border 0: paper 7: ink 1`
+			unsigned keywords = 6;
+			/// Number-heavy statements, like `data 1,0.5,1e3,0x1F`
+			unsigned numbers = 4;
+			/// Statements referencing `@label` symbols, like `gosub @label12`
+			unsigned labels = 2;
+			/// Strings with escape sequences, like `print "\a\b\::"`
+			unsigned escapes = 2;
+			/// REM lines
+			unsigned rems = 1;
+			/// Statements split into several source lines with `\`
+			unsigned continuations = 1;
+		};
+
+		/// The `Options` structure contains parameters of generated content.
+		struct Options
+		{
+			/// Seed for pseudo random generator.
+			U32 seed = 0x5EED;
+			/// Number of BASIC lines in generated program.
+			size_t lines = 1000;
+			/// After how many BASIC lines a new `@label` is declared.
+			size_t linesPerLabel = 32;
+			/// Statement kinds mix.
+			Mix mix;
+		};
+
+		/// Constructs generator with given |options|.
+		CorpusGenerator(const Options & options);
+
+		/// Returns options assigned to the generator.
+		const Options & options() const;
+
+		/// Generates a new BASIC program. Each call produces a different program, but
+		/// the sequence of programs is determined by the seed.
+		std::string program();
+
+		/// Generates block of pseudo random bytes with given |size|.
+		ByteArray codeBlock(size_t size);
+
+		/// Writes bastap document with name |name| into |directory|. The document contains
+		/// |programs| BASIC programs and |code_blocks| CODE blocks, each 6912 bytes long.
+		/// All referenced files are written to the same directory. Returns false if some file
+		/// cannot be written.
+		bool writeDocument(const std::string & directory, const std::string & name, size_t programs, size_t code_blocks);
+
+		/// Writes |content| into file at |path|. Returns false in case of failure.
+		static bool writeFile(const std::string & path, const ByteRange & content);
+
+	private:
+
+		/// Returns next pseudo random number.
+		U32 next();
+		/// Returns pseudo random number in range <0, n)
+		U32 nextBelow(U32 n);
+		/// Returns pseudo random number as string, in range <0, n)
+		std::string number(U32 n);
+
+		/// Appends one statement of given |kind| to |out|.
+		void appendStatement(std::string & out, unsigned kind, size_t labels_count);
+
+		Options _options;
+		U32 _state;
+	};
+
+} // bastapir::bench
+} // bastapir
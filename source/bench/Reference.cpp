@@ -0,0 +1,226 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Reference.h"
+#include <set>
+#include <math.h>
+#include <string.h>
+
+namespace bastapir
+{
+namespace bench
+{
+namespace reference
+{
+	// MARK: - LinearKeywords
+	
+	static const char * s_keywordsTable[] =
+	{
+		"rnd", "inkey$", "pi", "fn", "point", "screen$", "attr", "at", "tab", "val$",
+		"code", "val", "len", "sin", "cos", "tan", "asn", "acs", "atn", "ln", "exp",
+		"int", "sqr", "sgn", "abs", "peek", "in", "usr", "str$", "chr$", "not", "bin",
+		"or", "and", "<=", ">=", "<>", "line", "then", "to", "step", "deffn", "cat",
+		"format", "move", "erase", "open#", "close#", "merge", "verify", "beep",
+		"circle", "ink", "paper", "flash", "bright", "inverse", "over", "out", "lprint",
+		"llist", "stop", "read", "data", "restore", "new", "border", "continue", "dim",
+		"rem", "for", "goto", "gosub", "input", "load", "list", "let", "pause", "next",
+		"poke", "print", "plot", "run", "save", "randomize", "if", "cls", "draw", "clear",
+		"return", "copy",
+		nullptr
+	};
+	
+	static bool matchStringCI(const std::string & str, Tokenizer::iterator begin, Tokenizer::iterator end)
+	{
+		for (char c: str) {
+			if (begin == end) {
+				return false;
+			}
+			char d = *begin++;
+			if (tolower(c) != tolower(d)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	static bool findSpecialChar(const std::string & str)
+	{
+		if (str.begin() != str.end()) {
+			bool first_special = !isalpha(*str.begin());
+			bool last_special  = !isalpha(*(str.end() - 1));
+			return first_special || last_special;
+		}
+		return false;
+	}
+	
+	LinearKeywords::LinearKeywords(bas::Keywords::Dialect dialect)
+	{
+		byte code = 0xA5;
+		for (const char ** p = s_keywordsTable; *p; ++p) {
+			auto kws = std::string(*p);
+			_keywords.push_back(Keyword { kws, findSpecialChar(kws), code++ });
+		}
+		if (dialect == bas::Keywords::Dialect_128K) {
+			_keywords.push_back(Keyword { "spectrum", false, 0xA3 });
+			_keywords.push_back(Keyword { "play", false, 0xA4 });
+		}
+		std::sort(_keywords.begin(), _keywords.end(), [](const Keyword & k1, const Keyword & k2) {
+			return k1.keyword.size() > k2.keyword.size();
+		});
+		std::set<char> chars;
+		for (auto && keyword: _keywords) {
+			chars.insert(*keyword.keyword.begin());
+		}
+		_keywordsFirstChars.assign(chars.begin(), chars.end());
+	}
+	
+	byte LinearKeywords::findKeyword(Tokenizer::iterator begin, Tokenizer::iterator end, size_t & out_matched_size) const
+	{
+		if (begin != end) {
+			auto max_distance = std::distance(begin, end);
+			if (_keywordsFirstChars.find(tolower(*begin)) != std::string::npos) {
+				for (auto && kw: _keywords) {
+					if (matchStringCI(kw.keyword, begin, end)) {
+						size_t matched_size = kw.keyword.size();
+						if (!kw.special && max_distance > (ptrdiff_t)matched_size) {
+							const char c = *(begin + matched_size);
+							if (isalnum(c) || c == '_') {
+								continue;
+							}
+						}
+						out_matched_size = matched_size;
+						return kw.code;
+					}
+				}
+			}
+		}
+		return 0;
+	}
+	
+	// Escape codes, compatible with `zmakebas` program, in the order of matching.
+	
+	struct EscapeCode
+	{
+		const char * sequence;
+		byte code;
+	};
+	
+	static const EscapeCode s_escapeCodesTable[] =
+	{
+		// Block graphic
+		{ "  ", 0x80 }, { " '", 0x81 }, { "' ", 0x82 }, { "''", 0x83 },
+		{ " .", 0x84 }, { " :", 0x85 }, { "'.", 0x86 }, { "':", 0x87 },
+		{ ". ", 0x88 }, { ".'", 0x89 }, { ": ", 0x8A }, { ":'", 0x8B },
+		{ "..", 0x8C }, { ".:", 0x8D }, { ":.", 0x8E }, { "::", 0x8F },
+		// UDG
+		{ "a", 0x90 }, { "b", 0x91 }, { "c", 0x92 }, { "d", 0x93 }, { "e", 0x94 },
+		{ "f", 0x95 }, { "g", 0x96 }, { "h", 0x97 }, { "i", 0x98 }, { "j", 0x99 },
+		{ "k", 0x9A }, { "l", 0x9B }, { "m", 0x9C }, { "n", 0x9D }, { "o", 0x9E },
+		{ "p", 0x9F }, { "q", 0xA0 }, { "r", 0xA1 }, { "s", 0xA2 }, { "t", 0xA3 },
+		{ "u", 0xA4 },
+		// Additional codes
+		{ "*", 0x7F },		// copyright sign
+		{ "`", 0x60 },		// pound sign
+		{ "\\", '\\' },	// backslash
+		{ "@", '@' },		// @
+		// End of table
+		{ nullptr, 0 }
+	};
+	
+	static bool matchString(const char * str, Tokenizer::iterator begin, Tokenizer::iterator end)
+	{
+		for (; *str; ++str) {
+			if (begin == end) {
+				return false;
+			}
+			if (*str != *begin++) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
+	byte LinearKeywords::findEscapeCode(Tokenizer::iterator begin, Tokenizer::iterator end, size_t & out_matched_size) const
+	{
+		if (begin != end) {
+			for (const EscapeCode * ec = s_escapeCodesTable; ec->sequence; ++ec) {
+				if (matchString(ec->sequence, begin, end)) {
+					out_matched_size = strlen(ec->sequence);
+					return ec->code;
+				}
+			}
+		}
+		return 0;
+	}
+	
+	
+	// MARK: - dbl2spec
+	
+	// Original conversion routine written by Russell Marks, for his `zmakebas`
+	// text to BASIC converter.
+	
+	bool dbl2spec(double num, int & exp, long & man)
+	{
+		if (num >= -65535.0 && num <= 65535.0 && num == (long)num) {
+			long tmp = (long)fabs(num);
+			exp = 0;
+			man = ((tmp % 256) << 16) | ((tmp >> 8) << 8);
+		} else {
+			num = fabs(num);
+			exp = 0;
+			while (num >= 1.0) {
+				num /= 2.0;
+				exp++;
+			}
+			while (num < 0.5) {
+				num *= 2.0;
+				exp--;
+			}
+			if (exp < -128 || exp > 127) {
+				return false;
+			}
+			exp = 128 + exp;
+			num *= 2.0;
+			man = 0;
+			for (int f = 0; f < 32; f++) {
+				man <<= 1;
+				man |= (int)num;
+				num -= (int)num;
+				num *= 2.0;
+			}
+			if ((int)num && man != 0xFFFFFFFF) {
+				man++;
+			}
+			man &= 0x7FFFFFFF;
+		}
+		return true;
+	}
+	
+	// MARK: - Tape checksum
+	
+	byte copyWithChecksum(byte * destination, byte leading, const ByteRange & bytes)
+	{
+		byte checksum = leading;
+		for (byte b: bytes) {
+			*destination++ = b;
+			checksum ^= b;
+		}
+		return checksum;
+	}
+	
+} // bastapir::bench::reference
+} // bastapir::bench
+} // bastapir
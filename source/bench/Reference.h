@@ -0,0 +1,71 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/bas/Keywords.h>
+#include <bastapir/common/ByteRange.h>
+
+namespace bastapir
+{
+namespace bench
+{
+namespace reference
+{
+	//
+	// Reference implementations of algorithms replaced in the library. The benchmark
+	// compares the library against them, both in speed and in produced results.
+	//
+	
+	/// The `LinearKeywords` class is the original keywords matcher, which tries
+	/// all keywords one by one, from the longest to the shortest.
+	class LinearKeywords
+	{
+	public:
+		
+		/// Constructs matcher for given |dialect|
+		LinearKeywords(bas::Keywords::Dialect dialect);
+		
+		/// Works exactly like `Keywords::findKeyword()`
+		byte findKeyword(const Tokenizer::iterator begin, const Tokenizer::iterator end, size_t & out_matched_size) const;
+		
+		/// Works exactly like `Keywords::findEscapeCode()`, but tries all escape sequences one by one.
+		byte findEscapeCode(const Tokenizer::iterator begin, const Tokenizer::iterator end, size_t & out_matched_size) const;
+		
+	private:
+		
+		struct Keyword
+		{
+			std::string keyword;
+			bool special;
+			byte code;
+		};
+		
+		std::vector<Keyword> _keywords;
+		std::string _keywordsFirstChars;
+	};
+	
+	/// The original `bas::dbl2spec()` routine from `zmakebas`, which normalizes the number
+	/// and rolls mantissa bits off in loops.
+	bool dbl2spec(double num, int & exp, long & man);
+	
+	/// The original fused loop from `TapArchiveBuilder`, which copies |bytes| to |destination|
+	/// and calculates XOR checksum, one byte at a time.
+	byte copyWithChecksum(byte * destination, byte leading, const ByteRange & bytes);
+	
+} // bastapir::bench::reference
+} // bastapir::bench
+} // bastapir
@@ -0,0 +1,939 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "Benchmark.h"
+#include "CorpusGenerator.h"
+#include "Reference.h"
+#include "bas/Double2Speccy.h"
+#include <bastapir/BastapirDocument.h>
+#include <bastapir/tap/Checksum.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef BASTAPIR_BENCH_CORPUS
+#define BASTAPIR_BENCH_CORPUS "tests"
+#endif
+
+using namespace bastapir;
+using namespace bastapir::bench;
+
+namespace fs = std::filesystem;
+
+// MARK: - Corpus
+
+/// The `Corpus` structure contains list of source files, grouped by type.
+struct Corpus
+{
+	/// Name of corpus, used as prefix for stage names.
+	std::string name;
+	/// Directory with all files.
+	std::string directory;
+	/// Paths to BASIC source files.
+	StringVector programs;
+	/// Paths to bastap documents.
+	StringVector documents;
+	/// Options applied to parser for programs in this corpus.
+	bas::BasicTextParser::Options parserOptions;
+	/// If false, then programs are not measured one by one, but only as a part of the archive.
+	bool perProgramStages = true;
+};
+
+/// Loads list of `*.bas` and `*.bastap` files from given directory.
+static Corpus LoadCorpus(const std::string & name, const std::string & directory)
+{
+	Corpus corpus;
+	corpus.name = name;
+	corpus.directory = directory;
+	std::error_code ec;
+	for (auto && entry: fs::directory_iterator(directory, ec)) {
+		auto ext = entry.path().extension().string();
+		if (ext == ".bas") {
+			corpus.programs.push_back(entry.path().string());
+		} else if (ext == ".bastap") {
+			corpus.documents.push_back(entry.path().string());
+		}
+	}
+	std::sort(corpus.programs.begin(), corpus.programs.end());
+	std::sort(corpus.documents.begin(), corpus.documents.end());
+	return corpus;
+}
+
+/// Returns paths to all files referenced from bastap document. The function doesn't
+/// validate the document, it just looks for `basic "path"` and `code "path"` commands.
+static StringVector DocumentInputs(std::string_view document)
+{
+	StringVector inputs;
+	size_t pos = 0;
+	while (pos < document.size()) {
+		size_t eol = document.find('\n', pos);
+		if (eol == std::string::npos) {
+			eol = document.size();
+		}
+		auto line = document.substr(pos, eol - pos);
+		pos = eol + 1;
+		auto first = line.find_first_not_of(" \t");
+		if (first == std::string::npos) {
+			continue;
+		}
+		if (line.compare(first, 5, "basic") != 0 && line.compare(first, 4, "code") != 0) {
+			continue;
+		}
+		auto q1 = line.find('"', first);
+		auto q2 = q1 != std::string::npos ? line.find('"', q1 + 1) : std::string::npos;
+		if (q2 != std::string::npos) {
+			inputs.push_back(std::string(line.substr(q1 + 1, q2 - q1 - 1)));
+		}
+	}
+	return inputs;
+}
+
+
+// MARK: - Synthetic corpus
+
+/// Sizes of programs in the scaling sweep, in BASIC lines.
+static const size_t s_sweepSizes[] = { 250, 500, 1000, 2000, 4000, 8000 };
+
+/// Returns directory for generated corpus.
+static std::string SyntheticDirectory()
+{
+	auto directory = (fs::temp_directory_path() / "bastap_bench").string();
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	return directory;
+}
+
+/// Generates scaling sweep into the temporary directory. The corpus contains programs
+/// with growing number of lines, all generated with the same statement mix.
+static Corpus MakeScalingCorpus(const CorpusGenerator::Options & options)
+{
+	auto directory = SyntheticDirectory() + "/scaling";
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	for (auto lines: s_sweepSizes) {
+		auto generator_options = options;
+		generator_options.lines = lines;
+		CorpusGenerator generator(generator_options);
+		char name[32];
+		snprintf(name, sizeof(name), "/lines-%05zu.bas", lines);
+		CorpusGenerator::writeFile(directory + name, MakeRange(generator.program()));
+	}
+	Corpus corpus = LoadCorpus("scaling", directory);
+	// Long programs don't fit into the default line numbering.
+	corpus.parserOptions.initialLineNumber = 1;
+	corpus.parserOptions.lineNumberIncrement = 1;
+	return corpus;
+}
+
+/// Generates many-entry document into the temporary directory.
+static Corpus MakeDocumentCorpus(const CorpusGenerator::Options & options, size_t programs, size_t code_blocks)
+{
+	auto directory = SyntheticDirectory() + "/document";
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	CorpusGenerator generator(options);
+	generator.writeDocument(directory, "synthetic", programs, code_blocks);
+	Corpus corpus = LoadCorpus("synthetic", directory);
+	corpus.perProgramStages = false;
+	return corpus;
+}
+
+
+// MARK: - Stages
+
+/// Measures plain `Tokenizer` walk over each program in the corpus. The walk skips
+/// whitespace and words, the same way as the parser does, but doesn't produce anything.
+static void BenchTokenize(Benchmark & bench, const Corpus & corpus)
+{
+	for (auto && path: corpus.programs) {
+		SourceTextFile file(path);
+		if (!file.isValid()) {
+			continue;
+		}
+		auto name = "tokenize " + corpus.name + "/" + fs::path(path).filename().string();
+		Tokenizer tokenizer;
+		tokenizer.setStopAtLineEnd(true);
+		bench.measure(name, CountLines(file.string()), file.string().size(), [&]() -> bool {
+			const auto text = file.string();
+			tokenizer.resetTo(text.data(), text.data() + text.size());
+			size_t tokens = 0;
+			do {
+				while (true) {
+					tokenizer.skipWhitespace();
+					const char c = tokenizer.charAt();
+					if (c == 0) {
+						break;
+					}
+					if (isalnum(c)) {
+						tokenizer.skipAlphanumeric();
+					} else {
+						tokenizer.movePosition();
+					}
+					tokens++;
+				}
+			} while (tokenizer.nextLine());
+			return tokens > 0;
+		});
+	}
+}
+
+/// Measures `Keywords::findKeyword` against the original linear matcher. The lookups are made at
+/// beginning of each token in all programs from the corpus, so both matchers see the same mix
+/// of keywords, variables, numbers and operators. Returns false if matchers produce different results.
+static bool BenchKeywords(Benchmark & bench, const Corpus & corpus)
+{
+	auto trie_name = "keywords trie " + corpus.name;
+	auto linear_name = "keywords linear " + corpus.name;
+	if (!bench.isEnabled(trie_name) && !bench.isEnabled(linear_name)) {
+		return true;
+	}
+	// Load all texts first, the lookups keep iterators to them.
+	StringVector texts;
+	for (auto && path: corpus.programs) {
+		SourceTextFile file(path);
+		if (file.isValid()) {
+			texts.push_back(std::string(file.string()));
+		}
+	}
+	struct Lookup
+	{
+		Tokenizer::iterator begin;
+		Tokenizer::iterator end;
+	};
+	std::vector<Lookup> lookups;
+	size_t bytes = 0;
+	for (auto && text: texts) {
+		bytes += text.size();
+		Tokenizer tokenizer;
+		tokenizer.setStopAtLineEnd(true);
+		tokenizer.resetTo(text.data(), text.data() + text.size());
+		do {
+			while (tokenizer.skipWhitespace()) {
+				lookups.push_back(Lookup { tokenizer.position(), tokenizer.limit().end });
+				if (isalnum(tokenizer.charAt())) {
+					tokenizer.skipAlphanumeric();
+				} else {
+					tokenizer.movePosition();
+				}
+			}
+		} while (tokenizer.nextLine());
+	}
+	if (lookups.empty()) {
+		return true;
+	}
+	
+	bas::Keywords keywords(bas::Keywords::Dialect_128K);
+	reference::LinearKeywords linear(bas::Keywords::Dialect_128K);
+	
+	// Both matchers must produce the same results.
+	for (auto && lookup: lookups) {
+		size_t size1 = 0, size2 = 0;
+		byte code1 = keywords.findKeyword(lookup.begin, lookup.end, size1);
+		byte code2 = linear.findKeyword(lookup.begin, lookup.end, size2);
+		if (code1 != code2 || size1 != size2) {
+			fprintf(stderr, "bench: Keywords mismatch at `%s`\n", std::string(lookup.begin, lookup.end).c_str());
+			return false;
+		}
+	}
+	bench.measure(trie_name, lookups.size(), bytes, [&]() -> bool {
+		size_t found = 0;
+		for (auto && lookup: lookups) {
+			size_t matched_size;
+			found += keywords.findKeyword(lookup.begin, lookup.end, matched_size) != 0;
+		}
+		return found > 0;
+	});
+	bench.measure(linear_name, lookups.size(), bytes, [&]() -> bool {
+		size_t found = 0;
+		for (auto && lookup: lookups) {
+			size_t matched_size;
+			found += linear.findKeyword(lookup.begin, lookup.end, matched_size) != 0;
+		}
+		return found > 0;
+	});
+	return true;
+}
+
+/// Compares `Keywords::findEscapeCode` with the original linear search, in both dialects. The lookups
+/// are made for all sequences up to 3 characters long, composed from printable characters, NUL and
+/// non-ASCII characters. Returns false if searches produce different results.
+static bool CheckEscapeCodes(Benchmark & bench)
+{
+	if (!bench.isEnabled("escape codes check")) {
+		return true;
+	}
+	std::string alphabet;
+	for (int c = 0x20; c < 0x7F; c++) {
+		alphabet.push_back((char)c);
+	}
+	alphabet.push_back('\0');
+	alphabet.push_back('\x80');
+	alphabet.push_back('\xFF');
+	
+	size_t lookups = 0;
+	for (auto dialect: { bas::Keywords::Dialect_48K, bas::Keywords::Dialect_128K }) {
+		bas::Keywords keywords(dialect);
+		reference::LinearKeywords linear(dialect);
+		// Each sequence of given length is enumerated as number in base of alphabet size.
+		for (size_t length = 0; length <= 3; length++) {
+			size_t count = 1;
+			for (size_t i = 0; i < length; i++) {
+				count *= alphabet.size();
+			}
+			for (size_t n = 0; n < count; n++) {
+				char sequence[3];
+				for (size_t i = 0, digits = n; i < length; i++, digits /= alphabet.size()) {
+					sequence[i] = alphabet[digits % alphabet.size()];
+				}
+				size_t size1 = 0, size2 = 0;
+				byte code1 = keywords.findEscapeCode(sequence, sequence + length, size1);
+				byte code2 = linear.findEscapeCode(sequence, sequence + length, size2);
+				if (code1 != code2 || size1 != size2) {
+					fprintf(stderr, "bench: Escape code mismatch at `%s`: %02X/%zu vs %02X/%zu\n",
+							std::string(sequence, length).c_str(), code1, size1, code2, size2);
+					return false;
+				}
+				++lookups;
+			}
+		}
+	}
+	printf("escape codes: %zu lookups are equal to reference\n", lookups);
+	return true;
+}
+
+/// Prints throughput of stages with |name| prefix, compared to stages with |reference| prefix
+/// and the same suffix. The throughput is taken from `lines` column, so it's up to the stage
+/// what it counts.
+static void PrintComparison(const Benchmark & bench, const std::string & title, const std::string & name, const std::string & reference)
+{
+	bool header = false;
+	for (auto && m: bench.results()) {
+		if (m.name.compare(0, name.size(), name) != 0) {
+			continue;
+		}
+		auto suffix = m.name.substr(name.size());
+		for (auto && r: bench.results()) {
+			if (r.name != reference + suffix) {
+				continue;
+			}
+			if (!header) {
+				header = true;
+				printf("\n%s:\n", title.c_str());
+				printf("%-16s %14s %14s %8s\n", "corpus", "new/s", "reference/s", "speedup");
+			}
+			printf("%-16s %14.0f %14.0f %8.2f\n", suffix.empty() ? "-" : suffix.c_str(), m.linesPerSecond(), r.linesPerSecond(),
+				   m.linesPerSecond() / r.linesPerSecond());
+		}
+	}
+}
+
+/// Simple xorshift generator for the fuzz tests.
+static U64 NextRandom(U64 & state)
+{
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+/// Returns double with random mantissa, sign and exponent in range <min_exp, max_exp>.
+static double RandomDouble(U64 & state, int min_exp, int max_exp)
+{
+	U64 bits = NextRandom(state);
+	U64 exponent = 1023 + min_exp + (int)(NextRandom(state) % (U64)(max_exp - min_exp + 1));
+	bits = (bits & 0x800FFFFFFFFFFFFFull) | (exponent << 52);
+	double value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/// Compares `bas::dbl2spec()` with the original routine, bit for bit, for |fuzz_count| random
+/// values and for known edge cases. Then measures both routines. Returns false on mismatch.
+static bool BenchDbl2spec(Benchmark & bench, size_t fuzz_count)
+{
+	const std::string exact_name = "dbl2spec exact";
+	const std::string reference_name = "dbl2spec reference";
+	if (!bench.isEnabled(exact_name) && !bench.isEnabled(reference_name)) {
+		return true;
+	}
+	std::vector<double> values = {
+		0.0, -0.0, 0.5, 1.0, 1.5, 65535.0, -65535.0, 65535.5, 65536.0, -65536.0, 1e10, 1e-10, 0.1, 3.14159,
+		ldexp(1.0, 126), ldexp(1.0, 127), ldexp(1.0, -129), ldexp(1.0, -130), ldexp(1.0, -1074),
+		ldexp(1.0 - ldexp(1.0, -53), 127), ldexp(1.0 - ldexp(1.0, -53), -128), DBL_MAX, DBL_MIN, -DBL_MAX,
+		ldexp((double)0xFFFFFFFFull + 0.5, -32), ldexp((double)0xFFFFFFFEull + 0.5, -32), ldexp((double)0x80000000ull + 0.5, -32),
+	};
+	U64 state = 0x5EED5EED5EED5EEDull;
+	for (size_t i = 0; i < fuzz_count; i++) {
+		switch (i % 4) {
+			case 0: {
+				// Any finite double
+				U64 bits = NextRandom(state);
+				double value;
+				memcpy(&value, &bits, sizeof(value));
+				if (std::isfinite(value)) {
+					values.push_back(value);
+				}
+				break;
+			}
+			case 1:
+				// Around the supported exponent range
+				values.push_back(RandomDouble(state, -140, 140));
+				break;
+			case 2:
+				// Integers around the small integer limit
+				values.push_back((double)((int)(NextRandom(state) % 140000) - 70000));
+				break;
+			default:
+				// Decimal fractions, like in BASIC source code
+				values.push_back((double)(NextRandom(state) % 1000000) / 1000.0);
+				break;
+		}
+	}
+	for (double value: values) {
+		int exp1 = 0, exp2 = 0;
+		long man1 = 0, man2 = 0;
+		bool result1 = bas::dbl2spec(value, exp1, man1);
+		bool result2 = reference::dbl2spec(value, exp2, man2);
+		if (result1 != result2 || (result1 && (exp1 != exp2 || man1 != man2))) {
+			fprintf(stderr, "bench: dbl2spec mismatch for %a: %d/%02X/%08lX, reference %d/%02X/%08lX\n",
+					value, result1, exp1, man1, result2, exp2, man2);
+			return false;
+		}
+	}
+	printf("dbl2spec: %zu values are equal to reference\n", values.size());
+	
+	// Measure values from BASIC programs, which are not small integers.
+	std::vector<double> samples;
+	for (size_t i = 0; i < 4096; i++) {
+		samples.push_back(RandomDouble(state, -20, 20));
+	}
+	bench.measure(exact_name, samples.size(), samples.size() * sizeof(double), [&]() -> bool {
+		long sum = 0;
+		for (double value: samples) {
+			int exp;
+			long man;
+			sum += bas::dbl2spec(value, exp, man) ? man : 0;
+		}
+		return sum != 0;
+	});
+	bench.measure(reference_name, samples.size(), samples.size() * sizeof(double), [&]() -> bool {
+		long sum = 0;
+		for (double value: samples) {
+			int exp;
+			long man;
+			sum += reference::dbl2spec(value, exp, man) ? man : 0;
+		}
+		return sum != 0;
+	});
+	return true;
+}
+
+/// Compares `tap::CopyWithChecksum()` and `tap::XorChecksum()` with the original byte loop, for all
+/// sizes up to 300 bytes and all alignments of source and destination. Then measures the routines
+/// on 48 KiB blocks, which is the size of the whole RAM of 48K machine. Returns false on mismatch.
+static bool BenchChecksum(Benchmark & bench)
+{
+	const std::string copy_name = "checksum copy 48K";
+	const std::string xor_name = "checksum xor 48K";
+	const std::string reference_name = "checksum reference 48K";
+	if (!bench.isEnabled(copy_name) && !bench.isEnabled(xor_name) && !bench.isEnabled(reference_name)) {
+		return true;
+	}
+	const size_t block_size = 48 * 1024;
+	U64 state = 0xC0DEC0DEC0DEC0DEull;
+	ByteArray source(block_size + 64, 0);
+	for (auto && b: source) {
+		b = static_cast<byte>(NextRandom(state));
+	}
+	ByteArray destination(block_size + 64, 0);
+	ByteArray expected(block_size + 64, 0);
+	size_t tests = 0;
+	for (size_t size = 0; size <= 300; size++) {
+		for (size_t offset = 0; offset < 32; offset++) {
+			const auto range = ByteRange(source.data() + offset, size);
+			byte * out = destination.data() + 31 - offset;
+			const byte leading = static_cast<byte>(size);
+			const byte result1 = tap::CopyWithChecksum(out, leading, range);
+			const byte result2 = reference::copyWithChecksum(expected.data(), leading, range);
+			const byte result3 = tap::XorChecksum(leading, range);
+			if (result1 != result2 || result3 != result2 || memcmp(out, expected.data(), size) != 0) {
+				fprintf(stderr, "bench: checksum mismatch for size %zu, offset %zu\n", size, offset);
+				return false;
+			}
+			tests++;
+		}
+	}
+	printf("checksum: %zu blocks are equal to reference (%s)\n", tests, tap::ChecksumInstructionSet());
+	
+	const auto block = ByteRange(source.data(), block_size);
+	bench.measure(copy_name, 1, block_size, [&]() -> bool {
+		destination[block_size] = tap::CopyWithChecksum(destination.data(), 0xFF, block);
+		return destination[0] == source[0];
+	});
+	bench.measure(xor_name, 1, block_size, [&]() -> bool {
+		destination[block_size] = tap::XorChecksum(0xFF, block);
+		return true;
+	});
+	bench.measure(reference_name, 1, block_size, [&]() -> bool {
+		destination[block_size] = reference::copyWithChecksum(destination.data(), 0xFF, block);
+		return destination[0] == source[0];
+	});
+	return true;
+}
+
+/// Reads all lines from |stream| to |lines|.
+static void ReadLines(FILE * stream, StringVector & lines)
+{
+	rewind(stream);
+	char buffer[256];
+	while (fgets(buffer, sizeof(buffer), stream)) {
+		lines.push_back(buffer);
+	}
+}
+
+/// Reports messages from many threads into one shared logger, which forwards them to
+/// a file logger. Then verifies that each message is written exactly once, as a complete
+/// line, and that counters of both loggers are exact. Returns false on mismatch.
+static bool CheckSharedLoggers(Benchmark & bench)
+{
+	if (!bench.isEnabled("loggers shared")) {
+		return true;
+	}
+	const size_t threads = 8;
+	const size_t jobs = 200;
+	const size_t messages = 50;
+	FILE * out = tmpfile();
+	FILE * err = tmpfile();
+	if (!out || !err) {
+		fprintf(stderr, "bench: Unable to create temporary file for logger check\n");
+		return false;
+	}
+	FileErrorLogger file_log(out, err, true);
+	RedirectingErrorLogger log;
+	log.addChildLogger(&file_log);
+	ThreadPool pool(threads);
+	pool.run(jobs, [&](size_t job) {
+		auto info = ErrorInfo { "job" + std::to_string(job) + ".bas", 0, 1 };
+		for (size_t i = 0; i < messages; i++) {
+			info.line = i + 1;
+			const auto message = "message " + std::to_string(job) + "/" + std::to_string(i);
+			switch (i % 3) {
+				case 0: log.error(info, message); break;
+				case 1: log.warning(info, message); break;
+				default: log.info(info, message); break;
+			}
+		}
+	});
+	
+	// Compare all written lines with expected ones, in any order.
+	StringVector expected;
+	for (size_t job = 0; job < jobs; job++) {
+		for (size_t i = 0; i < messages; i++) {
+			static const char * severities[] = { "error: ", "warning: ", "" };
+			expected.push_back("job" + std::to_string(job) + ".bas:" + std::to_string(i + 1) + ":1: " + severities[i % 3] +
+							   "message " + std::to_string(job) + "/" + std::to_string(i) + "\n");
+		}
+	}
+	fflush(out);
+	fflush(err);
+	StringVector lines;
+	ReadLines(out, lines);
+	ReadLines(err, lines);
+	std::sort(expected.begin(), expected.end());
+	std::sort(lines.begin(), lines.end());
+	const int errors = (int)(jobs * ((messages + 2) / 3));
+	const int warnings = (int)(jobs * ((messages + 1) / 3));
+	const auto info1 = log.getInfo();
+	const auto info2 = file_log.getInfo();
+	if (lines != expected || info1.errorsCount != errors || info1.warningsCount != warnings ||
+		info2.errorsCount != errors || info2.warningsCount != warnings) {
+		fprintf(stderr, "bench: Shared loggers lost or broke messages: %zu lines, %d/%d errors, %d/%d warnings\n",
+				lines.size(), info1.errorsCount, info2.errorsCount, info1.warningsCount, info2.warningsCount);
+		return false;
+	}
+	printf("loggers: %zu messages from %zu threads are complete\n", lines.size(), pool.threadsCount());
+	return true;
+}
+
+/// Returns true if both loggers contain the same messages.
+static bool SameMessages(const BufferedErrorLogger & log1, const BufferedErrorLogger & log2)
+{
+	auto & m1 = log1.messages();
+	auto & m2 = log2.messages();
+	return std::equal(m1.begin(), m1.end(), m2.begin(), m2.end(), [](const BufferedErrorLogger::Message & a, const BufferedErrorLogger::Message & b) {
+		return a.severity == b.severity && a.info.sourceFile == b.info.sourceFile && a.info.line == b.info.line &&
+			   a.info.column == b.info.column && a.message == b.message;
+	});
+}
+
+/// Parses each program in single pass and in two passes, in both dialects, and verifies that
+/// both modes produce the same result, program bytes, messages and `autostart` value. The
+/// programs are taken from all |corpora|, from |generated_count| synthetic programs and from
+/// edge cases with symbolic line numbers. Returns false on mismatch.
+static bool CheckSinglePass(Benchmark & bench, const std::vector<Corpus> & corpora, const CorpusGenerator::Options & generator_options, size_t generated_count)
+{
+	if (!bench.isEnabled("single pass check")) {
+		return true;
+	}
+	struct Program
+	{
+		std::string name;
+		std::string text;
+	};
+	std::vector<Program> programs = {
+		{ "forward.bas", "goto @end\nprint 1\n@end:\nstop\n" },
+		{ "backward.bas", "@loop:\nprint 1\ngoto @loop\n" },
+		{ "last.bas", "goto @last\nprint 1\n@last:\n" },
+		{ "only-labels.bas", "@a:\n@b:\n" },
+		{ "duplicate.bas", "@a:\nprint 1\n@a:\nprint 2\n" },
+		{ "undefined.bas", "goto @nowhere\n" },
+		{ "expression.bas", "let a=@x+1:goto @x\n@x:\nprint a\n" },
+		{ "case.bas", "@Lab:\ngoto @lab\ngoto @LAB\n" },
+		{ "continuation.bas", "print \\\n @e\n@e:\nstop\n" },
+		{ "string.bas", "print \"@x\"\n@x:\n" },
+		{ "numbered.bas", "10 goto @l\n@l:\n20 print 1\n" },
+		{ "autostart.bas", "@autostart:\nprint 1\ngosub @sub\nstop\n@sub:\nreturn\n" },
+		{ "empty.bas", "" },
+	};
+	for (auto && corpus: corpora) {
+		for (auto && path: corpus.programs) {
+			SourceTextFile file(path);
+			if (file.isValid()) {
+				programs.push_back({ path, std::string(file.string()) });
+			}
+		}
+	}
+	auto options = generator_options;
+	options.lines = 200;
+	for (size_t i = 0; i < generated_count; i++) {
+		options.seed = generator_options.seed + (U32)i;
+		CorpusGenerator generator(options);
+		programs.push_back({ "generated" + std::to_string(i) + ".bas", generator.program() });
+	}
+	
+	size_t tests = 0;
+	for (auto && program: programs) {
+		for (auto dialect: { bas::Keywords::Dialect_48K, bas::Keywords::Dialect_128K }) {
+			const auto info = SourceFileInfo { program.name, SourceFileInfo::Text };
+			BufferedErrorLogger log1, log2;
+			bas::BasicTextParser single(&log1), two(&log2);
+			single.options().singlePass = true;
+			two.options().singlePass = false;
+			const bool result1 = single.parse(program.text, info, dialect);
+			const bool result2 = two.parse(program.text, info, dialect);
+			if (result1 != result2 || !SameMessages(log1, log2) || single.resolveVariable("autostart") != two.resolveVariable("autostart") ||
+				(result1 && single.programBytes() != two.programBytes())) {
+				fprintf(stderr, "bench: Single pass and two pass parse differ for %s\n", program.name.c_str());
+				return false;
+			}
+			tests++;
+		}
+	}
+	printf("single pass: %zu parses are equal to two pass parses\n", tests);
+	return true;
+}
+
+/// Prints how the time per line changes with size of program, for given |stage|. The ratio
+/// is relative to the smallest program, so the value close to 1.0 means linear scaling.
+static void PrintScaling(const Benchmark & bench, const std::string & stage)
+{
+	const Measurement * base = nullptr;
+	for (auto && m: bench.results()) {
+		if (m.name.compare(0, stage.size(), stage) != 0 || m.lines == 0) {
+			continue;
+		}
+		double ns_per_line = 1e9 * m.seconds / (double)(m.iterations * m.lines);
+		if (!base) {
+			base = &m;
+			printf("\nScaling of `%s`:\n", stage.c_str());
+			printf("%10s %12s %8s\n", "lines", "ns/line", "ratio");
+		}
+		double base_ns_per_line = 1e9 * base->seconds / (double)(base->iterations * base->lines);
+		printf("%10zu %12.1f %8.2f\n", m.lines, ns_per_line, ns_per_line / base_ns_per_line);
+	}
+}
+
+/// The `NumberCacheReport` structure contains number cache counters from one parsed program.
+struct NumberCacheReport
+{
+	std::string name;
+	bas::BasicTextParser::Statistics statistics;
+};
+
+/// Measures `BasicTextParser::parse` for each program in the corpus. The number cache counters
+/// from the last parse of each program are appended to |reports|.
+static void BenchParse(Benchmark & bench, ErrorLogging & log, const Corpus & corpus, std::vector<NumberCacheReport> & reports)
+{
+	for (auto && path: corpus.programs) {
+		SourceTextFile file(path);
+		if (!file.isValid()) {
+			fprintf(stderr, "bench: Unable to open %s\n", path.c_str());
+			continue;
+		}
+		auto name = "parse " + corpus.name + "/" + fs::path(path).filename().string();
+		bas::BasicTextParser parser(&log);
+		parser.setOptions(corpus.parserOptions);
+		if (bench.measure(name, CountLines(file.string()), file.string().size(), [&]() -> bool {
+			return parser.parse(file.string(), file.info());
+		})) {
+			reports.push_back(NumberCacheReport { name.substr(6), parser.statistics() });
+		}
+	}
+}
+
+/// Prints number cache counters collected in `BenchParse()`.
+static void PrintNumberCache(const std::vector<NumberCacheReport> & reports)
+{
+	if (reports.empty()) {
+		return;
+	}
+	printf("\nNumber cache (per parse):\n");
+	printf("%-40s %10s %10s %10s %8s\n", "program", "small int", "hits", "misses", "hit %");
+	for (auto && r: reports) {
+		const size_t total = r.statistics.numberCacheHits + r.statistics.numberCacheMisses;
+		printf("%-40s %10zu %10zu %10zu %8.1f\n", r.name.c_str(), r.statistics.smallIntegers, r.statistics.numberCacheHits,
+			   r.statistics.numberCacheMisses, total > 0 ? 100.0 * r.statistics.numberCacheHits / total : 0.0);
+	}
+}
+
+/// Measures `TapArchiveBuilder::build` for archive containing all programs from the corpus. The same
+/// archive is also streamed with `TapArchiveBuilder::write` to the null device.
+static void BenchBuild(Benchmark & bench, ErrorLogging & log, const Corpus & corpus)
+{
+	auto name = "build " + corpus.name;
+	auto stream_name = "stream " + corpus.name;
+	if (!bench.isEnabled(name) && !bench.isEnabled(stream_name)) {
+		return;
+	}
+	tap::TapArchiveBuilder builder(&log);
+	size_t lines = 0;
+	for (auto && path: corpus.programs) {
+		SourceTextFile file(path);
+		bas::BasicTextParser parser(&log);
+		parser.setOptions(corpus.parserOptions);
+		if (!file.isValid() || !parser.parse(file.string(), file.info())) {
+			continue;
+		}
+		if (parser.programBytes().size() > 40000) {
+			// Too big for TAP, builder would refuse such program.
+			continue;
+		}
+		auto entry = tap::FileEntry(fs::path(path).stem().string(), tap::FileEntry::Program, parser.programBytes());
+		auto params = tap::FileEntry::Params();
+		params.program.autostartLine = tap::FileEntry::Params::NO_AUTOSTART;
+		params.program.variableArea = parser.programBytes().size();
+		entry.setParams(params);
+		builder.addFile(entry);
+		lines += CountLines(file.string());
+	}
+	size_t output_size = builder.build().size();
+	bench.measure(name, lines, output_size, [&]() -> bool {
+		return !builder.build().empty();
+	});
+	if (bench.isEnabled(stream_name)) {
+		int fd = open("/dev/null", O_WRONLY);
+		if (fd < 0) {
+			fprintf(stderr, "bench: Unable to open /dev/null\n");
+			return;
+		}
+		bench.measure(stream_name, lines, output_size, [&]() -> bool {
+			tap::FileDescriptorSink sink(fd);
+			return builder.write(sink) && sink.writtenBytes() == output_size;
+		});
+		close(fd);
+	}
+}
+
+/// Measures `BastapirDocument::processDocument` for each document in the corpus.
+static void BenchDocuments(Benchmark & bench, ErrorLogging & log, const Corpus & corpus)
+{
+	std::error_code ec;
+	auto cwd = fs::current_path(ec);
+	// Documents refer to files relative to the working directory.
+	fs::current_path(corpus.directory, ec);
+	for (auto && path: corpus.documents) {
+		SourceTextFile file(path);
+		if (!file.isValid()) {
+			fprintf(stderr, "bench: Unable to open %s\n", path.c_str());
+			continue;
+		}
+		size_t lines = CountLines(file.string());
+		size_t bytes = file.string().size();
+		for (auto && input: DocumentInputs(file.string())) {
+			SourceTextFile input_file(input);
+			lines += CountLines(input_file.string());
+			bytes += input_file.string().size();
+		}
+		auto name = "document " + corpus.name + "/" + fs::path(path).filename().string();
+		bench.measure(name, lines, bytes, [&]() -> bool {
+			// The document accumulates files in its builder, so we need a fresh instance.
+			BastapirDocument doc(&log);
+			return doc.processDocument(file);
+		});
+	}
+	fs::current_path(cwd, ec);
+}
+
+
+// MARK: - Main
+
+static void PrintUsage(const char * program)
+{
+	printf("Usage: %s [options]\n", program);
+	printf("Options:\n");
+	printf("  --corpus DIR      Directory with *.bas and *.bastap files (default: %s)\n", BASTAPIR_BENCH_CORPUS);
+	printf("  --time SEC        Minimum time spent in each stage (default: 0.5)\n");
+	printf("  --filter TEXT     Measure only stages containing TEXT in name\n");
+	printf("  --no-synthetic    Don't generate and measure synthetic corpus\n");
+	printf("  --two-pass        Parse BASIC programs in two passes instead of single pass\n");
+	printf("  --fuzz N          Number of random values compared with reference routines (default: 1000000)\n");
+	printf("\n");
+	printf("Corpus generator:\n");
+	printf("  --generate DIR    Write synthetic program and document to DIR and exit\n");
+	printf("  --lines N         Number of BASIC lines in generated program (default: 1000)\n");
+	printf("  --entries N       Number of programs in generated document (default: 64)\n");
+	printf("  --code N          Number of CODE blocks in generated document (default: 8)\n");
+	printf("  --seed N          Seed for generator (default: %u)\n", CorpusGenerator::Options().seed);
+	printf("  --mix K,N,L,E,R,C Weights of keywords, numbers, labels, escapes, REMs, continuations\n");
+}
+
+/// Parses comma separated weights into |mix|. Returns false if string has wrong format.
+static bool ParseMix(const std::string & str, CorpusGenerator::Mix & mix)
+{
+	unsigned w[6];
+	if (sscanf(str.c_str(), "%u,%u,%u,%u,%u,%u", &w[0], &w[1], &w[2], &w[3], &w[4], &w[5]) != 6) {
+		return false;
+	}
+	mix.keywords = w[0];
+	mix.numbers = w[1];
+	mix.labels = w[2];
+	mix.escapes = w[3];
+	mix.rems = w[4];
+	mix.continuations = w[5];
+	return true;
+}
+
+int main(int argc, const char * argv[])
+{
+	std::string corpus_dir = BASTAPIR_BENCH_CORPUS;
+	std::string filter;
+	std::string generate_dir;
+	double min_time = 0.5;
+	bool synthetic = true;
+	bool two_pass = false;
+	size_t entries = 64;
+	size_t code_blocks = 8;
+	size_t fuzz_count = 1000000;
+	CorpusGenerator::Options generator_options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool has_value = i + 1 < argc;
+		if (arg == "--corpus" && has_value) {
+			corpus_dir = argv[++i];
+		} else if (arg == "--time" && has_value) {
+			min_time = std::stod(argv[++i]);
+		} else if (arg == "--filter" && has_value) {
+			filter = argv[++i];
+		} else if (arg == "--no-synthetic") {
+			synthetic = false;
+		} else if (arg == "--two-pass") {
+			two_pass = true;
+		} else if (arg == "--fuzz" && has_value) {
+			fuzz_count = std::stoul(argv[++i]);
+		} else if (arg == "--generate" && has_value) {
+			generate_dir = argv[++i];
+		} else if (arg == "--lines" && has_value) {
+			generator_options.lines = std::stoul(argv[++i]);
+		} else if (arg == "--entries" && has_value) {
+			entries = std::stoul(argv[++i]);
+		} else if (arg == "--code" && has_value) {
+			code_blocks = std::stoul(argv[++i]);
+		} else if (arg == "--seed" && has_value) {
+			generator_options.seed = (U32)std::stoul(argv[++i]);
+		} else if (arg == "--mix" && has_value && ParseMix(argv[i + 1], generator_options.mix)) {
+			++i;
+		} else {
+			PrintUsage(argv[0]);
+			return arg == "--help" || arg == "-h" ? 0 : 1;
+		}
+	}
+
+	if (!generate_dir.empty()) {
+		// Just generate corpus and exit.
+		std::error_code ec;
+		fs::create_directories(generate_dir, ec);
+		CorpusGenerator generator(generator_options);
+		bool result = CorpusGenerator::writeFile(generate_dir + "/program.bas", MakeRange(generator.program()));
+		auto document_options = generator_options;
+		document_options.lines = 300;
+		CorpusGenerator document_generator(document_options);
+		result = result && document_generator.writeDocument(generate_dir, "document", entries, code_blocks);
+		if (!result) {
+			fprintf(stderr, "bench: Unable to write corpus to %s\n", generate_dir.c_str());
+		}
+		return result ? 0 : 1;
+	}
+
+	FileErrorLogger log;
+	log.setMinimumDisplayedSeverity(ErrorLogging::SevError);
+
+	Benchmark bench(min_time);
+	bench.setFilter(filter);
+	bench.printHeader(stdout);
+
+	bool failed = !BenchDbl2spec(bench, fuzz_count);
+	failed |= !BenchChecksum(bench);
+	failed |= !CheckEscapeCodes(bench);
+	failed |= !CheckSharedLoggers(bench);
+
+	std::vector<Corpus> corpora;
+	std::vector<NumberCacheReport> number_cache;
+	corpora.push_back(LoadCorpus("tests", fs::absolute(corpus_dir).string()));
+	if (synthetic) {
+		corpora.push_back(MakeScalingCorpus(generator_options));
+		// Each entry must fit into TAP limits for BASIC program.
+		auto document_options = generator_options;
+		document_options.lines = 300;
+		corpora.push_back(MakeDocumentCorpus(document_options, entries, code_blocks));
+	}
+	failed |= !CheckSinglePass(bench, corpora, generator_options, 300);
+	for (auto && corpus: corpora) {
+		corpus.parserOptions.singlePass = !two_pass;
+		if (corpus.perProgramStages) {
+			BenchTokenize(bench, corpus);
+			failed |= !BenchKeywords(bench, corpus);
+			BenchParse(bench, log, corpus, number_cache);
+		}
+		BenchBuild(bench, log, corpus);
+		BenchDocuments(bench, log, corpus);
+	}
+	if (synthetic) {
+		PrintScaling(bench, "tokenize scaling/");
+		PrintScaling(bench, "parse scaling/");
+	}
+	PrintNumberCache(number_cache);
+	PrintComparison(bench, "Keyword lookups", "keywords trie ", "keywords linear ");
+	PrintComparison(bench, "dbl2spec conversions", "dbl2spec exact", "dbl2spec reference");
+	PrintComparison(bench, "Tape checksum", "checksum copy", "checksum reference");
+	return failed || log.getInfo().errorsCount > 0 ? 1 : 0;
+}
@@ -16,36 +16,96 @@
 
 #include <bastapir/BastapirDocument.h>
 #include <bastapir/common/ErrorLogging.h>
+#include <algorithm>
+#include <charconv>
 
 namespace bastapir
 {
+	// MARK: - Support functions
+	
+	// Returns true if |word| is equal to lowercase |command|, ignoring case of |word|.
+	static bool isCommand(std::string_view word, std::string_view command)
+	{
+		if (word.size() != command.size()) {
+			return false;
+		}
+		for (size_t i = 0; i < word.size(); i++) {
+			if (tolower(word[i]) != command[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+	
 	// MARK: - Class implementation
 	
 	BastapirDocument::BastapirDocument(ErrorLogging * log) :
 		_log(log),
+		_pool(nullptr),
+		_cache(nullptr),
+		_fileLoading(SourceFile::MapLargeFiles),
 		_tapBuilder(log)
 	{
 		assert(_log != nullptr);
 	}
 	
+	void BastapirDocument::setThreadPool(ThreadPool * pool)
+	{
+		_pool = pool;
+	}
+	
+	void BastapirDocument::setBuildCache(const BuildCache * cache)
+	{
+		_cache = cache;
+	}
+	
+	void BastapirDocument::setFileLoading(SourceFile::Loading loading)
+	{
+		_fileLoading = loading;
+	}
+	
+	SourceFile::Loading BastapirDocument::fileLoading() const
+	{
+		return _fileLoading;
+	}
+	
 	bool BastapirDocument::processDocument(const SourceTextFile & file)
+	{
+		if (!parseDocument(file)) {
+			return false;
+		}
+		_archiveBytes.reserve(_tapBuilder.archiveSize());
+		tap::ByteArraySink sink(_archiveBytes);
+		if (!writeArchive(sink)) {
+			_archiveBytes.clear();
+			return false;
+		}
+		return !_archiveBytes.empty();
+	}
+	
+	bool BastapirDocument::parseDocument(const SourceTextFile & file)
 	{
 		_archiveBytes.clear();
+		_outputFile.clear();
+		_dependencies.clear();
+		_tapBuilder.removeAllFiles();
 		if (!file.isValid()) {
 			return false;
 		}
 		// Reset tokenizer to new content
 		_tokenizer.setStopAtLineEnd(true);
-		_tokenizer.resetTo(file.string().begin(), file.string().end());
+		const auto content = file.string();
+		_tokenizer.resetTo(Tokenizer::Range { content.data(), content.data() + content.size() }, file.lineIndex());
 		_sourceFileInfo = file.info();
 		_tapBuilder.setSourceFileInfo(file.info());
 		
-		bool result = doParseDocument();
-		if (result) {
-			_archiveBytes = _tapBuilder.build();
-			result = !_archiveBytes.empty();
-		}
-		return result;
+		// Document without files produces no archive, which is treated as failure.
+		return doParseDocument() && _tapBuilder.validate() && _tapBuilder.archiveSize() > 0;
+	}
+	
+	bool BastapirDocument::writeArchive(tap::ArchiveSink & sink) const
+	{
+		return _tapBuilder.write(sink);
 	}
 	
 	const ByteRange BastapirDocument::archiveBytes() const
@@ -63,23 +123,65 @@ namespace bastapir
 		return !_outputFile.empty();
 	}
 	
+	const std::vector<std::string> & BastapirDocument::dependencies() const
+	{
+		return _dependencies;
+	}
+	
 	
 	// MARK: - Parser
 	
 	bool BastapirDocument::doParseDocument()
 	{
+		// Capture all commands first. Messages reported while parsing each line are kept
+		// in its command, so they're reported in order with messages from compilation.
+		std::vector<Command> commands;
+		ErrorLogging * document_log = _log;
 		while (true) {
-			if (!doParseLine()) {
-				return false;
+			commands.emplace_back();
+			Command & command = commands.back();
+			_log = &command.log;
+			command.result = doParseLine(command);
+			_log = document_log;
+			if (!command.result) {
+				break;
+			}
+			if (command.type == Command::None && command.log.isEmpty()) {
+				commands.pop_back();
 			}
 			if (!_tokenizer.nextLine()) {
 				break;
 			}
 		}
+		
+		// Load & compile all files
+		if (_pool) {
+			_pool->run(commands.size(), [&](size_t index) {
+				compileCommand(commands[index]);
+			});
+		} else {
+			for (auto && command: commands) {
+				if (!compileCommand(command)) {
+					break;
+				}
+			}
+		}
+		
+		// Report messages and add files to the archive, in document order. The processing stops
+		// at the first failed command, exactly like when all commands are processed sequentially.
+		for (auto && command: commands) {
+			command.log.flush(_log);
+			if (!command.result) {
+				return false;
+			}
+			if (command.entry) {
+				_tapBuilder.addFile(std::move(*command.entry));
+			}
+		}
 		return true;
 	}
 	
-	bool BastapirDocument::doParseLine()
+	bool BastapirDocument::doParseLine(Command & command)
 	{
 		//_tokenizer._debugInfo();
 		_tokenizer.skipWhitespace();
@@ -92,25 +194,27 @@ namespace bastapir
 			// comment, skip rest of the line
 			return true;
 		}
-		auto command = captureWord(true);
-		if (command.empty()) {
+		auto command_name = captureWord();
+		if (command_name.empty()) {
 			return false;
 		}
-		if (command == "basic") {
-			if (!doParseCmdProgram()) {
+		if (isCommand(command_name, "basic")) {
+			if (!doParseCmdProgram(command)) {
 				return false;
 			}
-		} else if (command == "code") {
-			if (!doParseCmdCode()) {
+		} else if (isCommand(command_name, "code")) {
+			if (!doParseCmdCode(command)) {
 				return false;
 			}
-		} else if (command == "output") {
+		} else if (isCommand(command_name, "output")) {
 			if (!doParseCmdOutput()) {
 				return false;
 			}
 		} else {
 			if (isalpha(_tokenizer.charAt())) {
-				_log->error(errInfoLC(), "Unknown command `" + command + "`");
+				auto lowercase_command = std::string(command_name);
+				std::transform(lowercase_command.begin(), lowercase_command.end(), lowercase_command.begin(), ::tolower);
+				_log->error(errInfoLC(), "Unknown command `" + lowercase_command + "`");
 			} else {
 				_log->error(errInfoLC(), "Unexpected character in document.");
 			}
@@ -119,7 +223,7 @@ namespace bastapir
 		return true;
 	}
 	
-	bool BastapirDocument::doParseCmdProgram()
+	bool BastapirDocument::doParseCmdProgram(Command & command)
 	{
 		// basic "path/to/basic" [ProgramName]
 		std::string path;
@@ -135,34 +239,11 @@ namespace bastapir
 			// get name from file
 			programName = Path::components(path).fileNameNoExt;
 		}
-		
-		// Load & parse basic file
-		SourceTextFile file = SourceTextFile(path);
-		if (!file.isValid()) {
-			_log->error(errInfoLC(), "Unable to open BASIC program file: " + path);
-			return false;
-		}
-		bas::BasicTextParser parser(_log);
-		if (!parser.parse(file.string(), file.info())) {
-			return false;
-		}
-		//printf("Very bad length %lu\n", parser.programBytes().size());
-		std::string autostart_var;
-		bool resolved;
-		std::tie(resolved, autostart_var) = parser.resolveVariable("autostart");
-		long autostart_line = tap::FileEntry::Params::NO_AUTOSTART;
-		if (resolved) {
-			autostart_line = std::stol(autostart_var);
-		}
-		
-		auto entry = tap::FileEntry(programName, tap::FileEntry::Program, parser.programBytes());
-		auto entry_params = tap::FileEntry::Params();
-		entry_params.program.autostartLine = autostart_line;
-		entry_params.program.variableArea = parser.programBytes().size();
-		entry.setParams(entry_params);
-		
-		_tapBuilder.addFile(entry);
-		
+		command.type = Command::Program;
+		command.path = path;
+		addDependency(path);
+		command.name = programName;
+		command.errorInfo = errInfoLC();
 		return true;
 	}
 	
@@ -179,7 +260,14 @@ namespace bastapir
 		return true;
 	}
 	
-	bool BastapirDocument::doParseCmdCode()
+	void BastapirDocument::addDependency(const std::string & path)
+	{
+		if (std::find(_dependencies.begin(), _dependencies.end(), path) == _dependencies.end()) {
+			_dependencies.push_back(path);
+		}
+	}
+	
+	bool BastapirDocument::doParseCmdCode(Command & command)
 	{
 		// code "path/to/bytes" Address [BytesName]
 		std::string path;
@@ -191,6 +279,10 @@ namespace bastapir
 		if (!captureNumber(address)) {
 			return false;
 		}
+		if (address < 0 || address > 0xFFFF) {
+			_log->error(errInfoLC(), "CODE address `" + std::to_string(address) + "` is out of range (0 to 65535).");
+			return false;
+		}
 		_tokenizer.skipWhitespace();
 		std::string codeName;
 		if (!captureWordOrString(codeName)) {
@@ -200,34 +292,110 @@ namespace bastapir
 			// get name from file
 			codeName = Path::components(path).fileNameNoExt;
 		}
-		
-		SourceBinaryFile file = SourceBinaryFile(path);
+		command.type = Command::Code;
+		command.path = path;
+		addDependency(path);
+		command.name = codeName;
+		command.address = address;
+		command.errorInfo = errInfoLC();
+		return true;
+	}
+	
+	
+	// MARK: - Compilation
+	
+	bool BastapirDocument::compileCommand(Command & command) const
+	{
+		if (command.result) {
+			if (command.type == Command::Program) {
+				command.result = compileProgram(command);
+			} else if (command.type == Command::Code) {
+				command.result = compileCode(command);
+			}
+		}
+		return command.result;
+	}
+	
+	bool BastapirDocument::compileProgram(Command & command) const
+	{
+		// Load & parse basic file
+		SourceTextFile file = SourceTextFile(command.path, _fileLoading);
 		if (!file.isValid()) {
-			_log->error(errInfoLC(), "Unable to open CODE bytes file: " + path);
+			command.log.error(command.errorInfo, "Unable to open BASIC program file: " + command.path);
+			return false;
+		}
+		const auto dialect = bas::Keywords::Dialect_48K;
+		BuildCache::Key key;
+		BuildCache::Program program;
+		if (_cache) {
+			const auto content = file.string();
+			key = BuildCache::programKey(file.info().path, ByteRange(content.data(), content.size()), dialect, bas::BasicTextParser::Options(), {});
+			if (_cache->loadProgram(key, program)) {
+				for (auto && message: program.messages) {
+					command.log.append(message);
+				}
+				setProgramEntry(command, std::move(program.bytes), program.autostartLine);
+				return true;
+			}
+		}
+		const size_t first_message = command.log.messages().size();
+		bas::BasicTextParser parser(&command.log);
+		if (!parser.parse(file, dialect)) {
 			return false;
 		}
+		std::string autostart_var;
+		bool resolved;
+		std::tie(resolved, autostart_var) = parser.resolveVariable("autostart");
+		long autostart_line = tap::FileEntry::Params::NO_AUTOSTART;
+		if (resolved) {
+			std::from_chars(autostart_var.data(), autostart_var.data() + autostart_var.size(), autostart_line);
+		}
 		
-		auto entry = tap::FileEntry(codeName, tap::FileEntry::Code, file.bytes());
+		program.bytes = parser.releaseProgramBytes();
+		program.autostartLine = autostart_line;
+		if (_cache) {
+			program.messages.assign(command.log.messages().begin() + first_message, command.log.messages().end());
+			if (!_cache->storeProgram(key, program)) {
+				command.log.warning(command.errorInfo, "Unable to store compiled program to build cache: " + _cache->directory());
+			}
+		}
+		setProgramEntry(command, std::move(program.bytes), autostart_line);
+		return true;
+	}
+	
+	void BastapirDocument::setProgramEntry(Command & command, ByteArray && bytes, long autostart_line) const
+	{
 		auto entry_params = tap::FileEntry::Params();
-		entry_params.code.address = address;
-		entry_params.code.constValue = 32768;
-		entry.setParams(entry_params);
+		entry_params.program.autostartLine = autostart_line;
+		entry_params.program.variableArea = bytes.size();
 		
-		_tapBuilder.addFile(entry);
+		command.entry.emplace(command.name, tap::FileEntry::Program, std::move(bytes));
+		command.entry->setParams(entry_params);
+	}
+	
+	bool BastapirDocument::compileCode(Command & command) const
+	{
+		SourceBinaryFile file = SourceBinaryFile(command.path, _fileLoading);
+		if (!file.isValid()) {
+			command.log.error(command.errorInfo, "Unable to open CODE bytes file: " + command.path);
+			return false;
+		}
 		
+		// The entry shares bytes loaded from the file, so the content is not copied again.
+		command.entry.emplace(command.name, tap::FileEntry::Code, file.bytes(), file.storage());
+		auto entry_params = tap::FileEntry::Params();
+		entry_params.code.address = command.address;
+		entry_params.code.constValue = 32768;
+		command.entry->setParams(entry_params);
 		return true;
 	}
 	
 	
-	std::string BastapirDocument::captureWord(bool lowercase)
+	std::string_view BastapirDocument::captureWord()
 	{
 		_tokenizer.resetCapture();
 		_tokenizer.skipWhile(isalpha);
-		auto word = _tokenizer.capture().content();
-		if (lowercase) {
-			std::transform(word.begin(), word.end(), word.begin(), ::tolower);
-		}
-		return word;
+		return _tokenizer.capture().view();
 	}
 	
 	
@@ -240,22 +408,25 @@ namespace bastapir
 				// Hexadecimal number
 				_tokenizer.movePosition(2);
 				_tokenizer.resetCapture();
-				_tokenizer.skipWhile([] (int c) -> int {
-					return (c >= '0' && c <= '9') ||
-							(c >= 'a' && c <= 'f') ||
-							(c >= 'A' && c <= 'F');
-				});
-				value = std::stol(_tokenizer.capture().content(), nullptr, 16);
-				return true;
+				_tokenizer.skipHexDigits();
+				return parseNumber(_tokenizer.capture().view(), 16, value, "Hexadecimal number is expected.");
 			}
 		}
 		// Decimal number
 		_tokenizer.resetCapture();
-		_tokenizer.skipWhile(isnumber);
-		auto word = _tokenizer.capture().content();
-		value = std::stol(word);
-		if (std::to_string(value) == word) {
-			_log->error(errInfoLC(), "Decimal number is expected.");
+		_tokenizer.skipDigits();
+		return parseNumber(_tokenizer.capture().view(), 10, value, "Decimal number is expected.");
+	}
+	
+	bool BastapirDocument::parseNumber(std::string_view word, int base, long & value, const char * error_message)
+	{
+		auto result = std::from_chars(word.data(), word.data() + word.size(), value, base);
+		if (result.ec == std::errc::result_out_of_range) {
+			_log->error(errInfoLC(), "Number `" + std::string(word) + "` is too big.");
+			return false;
+		}
+		if (result.ec != std::errc()) {
+			_log->error(errInfoLC(), error_message);
 			return false;
 		}
 		return true;
@@ -289,7 +460,7 @@ namespace bastapir
 		if (c == '"') {
 			return captureString(captured);
 		}
-		captured = captureWord(false);
+		captured = std::string(captureWord());
 		return true;
 	}
 	
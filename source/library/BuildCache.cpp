@@ -0,0 +1,383 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/BuildCache.h>
+#include <bastapir/common/Path.h>
+#include <bastapir/common/SourceFile.h>
+#include <stdio.h>
+#include <cstring>
+#include <atomic>
+#include <filesystem>
+
+#if BASTAPIR_UNIX
+	#include <unistd.h>
+#else
+	#include <process.h>
+#endif
+
+namespace bastapir
+{
+	/// Identifies the file format. Change the version whenever the format, or the output
+	/// of BASIC parser changes, so entries from older versions are ignored.
+	static const char ENTRY_MAGIC[4] = { 'B', 'A', 'P', 'C' };
+	static const byte ENTRY_VERSION = 1;
+	
+	/// Maximum size of programs kept in memory. If the limit is reached, then all
+	/// programs are removed from memory.
+	static const size_t MEMORY_LIMIT = 64 * 1024 * 1024;
+	
+	/// Source of unique names for temporary files.
+	static std::atomic<U32> s_temporaryFileId { 0 };
+	
+	// MARK: - Hashing
+	
+	/// The `KeyHasher` class computes 128-bit key from two independent 64-bit FNV-1a hashes.
+	class KeyHasher
+	{
+	public:
+		void add(const void * data, size_t size)
+		{
+			auto bytes = static_cast<const byte*>(data);
+			U64 h0 = _hash[0], h1 = _hash[1];
+			for (size_t i = 0; i < size; i++) {
+				h0 = (h0 ^ bytes[i]) * 0x100000001B3ull;
+				h1 = (h1 ^ bytes[i]) * 0x9E3779B97F4A7C15ull;
+			}
+			_hash[0] = h0;
+			_hash[1] = h1;
+		}
+		
+		void add(U64 value)
+		{
+			byte bytes[8];
+			for (size_t i = 0; i < 8; i++) {
+				bytes[i] = byte(value >> (i * 8));
+			}
+			add(bytes, sizeof(bytes));
+		}
+		
+		/// Adds string with its length, so consecutive strings can't be confused.
+		void add(std::string_view str)
+		{
+			add(U64(str.size()));
+			add(str.data(), str.size());
+		}
+		
+		BuildCache::Key key() const
+		{
+			return BuildCache::Key { { mix(_hash[0]), mix(_hash[1]) } };
+		}
+		
+	private:
+		/// Final mixing of hash bits (from SplitMix64).
+		static U64 mix(U64 h)
+		{
+			h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+			h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+			return h ^ (h >> 31);
+		}
+		
+		U64 _hash[2] = { 0xCBF29CE484222325ull, 0x84222325CBF29CE4ull };
+	};
+	
+	// MARK: - Serialization
+	
+	static void WriteU32(ByteArray & out, U32 value)
+	{
+		out.append({ byte(value), byte(value >> 8), byte(value >> 16), byte(value >> 24) });
+	}
+	
+	static void WriteU64(ByteArray & out, U64 value)
+	{
+		WriteU32(out, U32(value));
+		WriteU32(out, U32(value >> 32));
+	}
+	
+	static void WriteString(ByteArray & out, const std::string & str)
+	{
+		WriteU32(out, U32(str.size()));
+		out.append(ByteRange(str));
+	}
+	
+	/// The `EntryReader` class reads values from cache entry. Once the reader reaches
+	/// the end of entry, all following reads fail.
+	class EntryReader
+	{
+	public:
+		EntryReader(ByteRange bytes) :
+			_pos(bytes.data()),
+			_end(bytes.data() + bytes.size())
+		{
+		}
+		
+		bool readBytes(void * out, size_t size)
+		{
+			if (size_t(_end - _pos) < size) {
+				_pos = _end;
+				return false;
+			}
+			memcpy(out, _pos, size);
+			_pos += size;
+			return true;
+		}
+		
+		bool readU32(U32 & value)
+		{
+			byte b[4];
+			if (!readBytes(b, sizeof(b))) {
+				return false;
+			}
+			value = U32(b[0]) | (U32(b[1]) << 8) | (U32(b[2]) << 16) | (U32(b[3]) << 24);
+			return true;
+		}
+		
+		bool readU64(U64 & value)
+		{
+			U32 low, high;
+			if (!readU32(low) || !readU32(high)) {
+				return false;
+			}
+			value = U64(low) | (U64(high) << 32);
+			return true;
+		}
+		
+		bool readRange(ByteRange & range)
+		{
+			U32 size;
+			if (!readU32(size) || size_t(_end - _pos) < size) {
+				_pos = _end;
+				return false;
+			}
+			range.assign(_pos, size);
+			_pos += size;
+			return true;
+		}
+		
+		bool readString(std::string & str)
+		{
+			ByteRange range;
+			if (!readRange(range)) {
+				return false;
+			}
+			str.assign(reinterpret_cast<const char*>(range.data()), range.size());
+			return true;
+		}
+		
+		bool atEnd() const
+		{
+			return _pos == _end;
+		}
+		
+	private:
+		const byte * _pos;
+		const byte * _end;
+	};
+	
+	/// Returns identifier of the current process, which makes names of temporary files
+	/// unique between processes sharing the cache directory.
+	static unsigned long ProcessId()
+	{
+#if BASTAPIR_UNIX
+		return (unsigned long)getpid();
+#else
+		return (unsigned long)_getpid();
+#endif
+	}
+	
+	// MARK: - Key
+	
+	std::string BuildCache::Key::toString() const
+	{
+		static const char * hex = "0123456789abcdef";
+		std::string str;
+		str.reserve(32);
+		for (U64 h: hash) {
+			for (int shift = 60; shift >= 0; shift -= 4) {
+				str += hex[(h >> shift) & 0xF];
+			}
+		}
+		return str;
+	}
+	
+	// MARK: - Class implementation
+	
+	BuildCache::BuildCache(const std::string & directory) :
+		_directory(directory),
+		_memorySize(0)
+	{
+	}
+	
+	const std::string & BuildCache::directory() const
+	{
+		return _directory;
+	}
+	
+	BuildCache::Key BuildCache::programKey(const std::string & path, ByteRange source, bas::Keywords::Dialect dialect,
+										   const bas::BasicTextParser::Options & options,
+										   const std::vector<bas::BasicTextParser::Variable> & constants)
+	{
+		KeyHasher hasher;
+		hasher.add(&ENTRY_VERSION, 1);
+		// Path is part of the key, because it's reported in the messages.
+		hasher.add(path);
+		hasher.add(U64(dialect));
+		hasher.add(U64(options.initialLineNumber));
+		hasher.add(U64(options.lineNumberIncrement));
+		hasher.add(U64(options.shadowNumbers));
+		hasher.add(U64(options.singlePass));
+		hasher.add(U64(constants.size()));
+		for (auto && constant: constants) {
+			hasher.add(constant.name);
+			hasher.add(constant.value);
+		}
+		hasher.add(U64(source.size()));
+		hasher.add(source.data(), source.size());
+		return hasher.key();
+	}
+	
+	bool BuildCache::loadProgram(const Key & key, Program & program) const
+	{
+		{
+			std::lock_guard<std::mutex> lock(_memoryMutex);
+			auto it = _memory.find({ key.hash[0], key.hash[1] });
+			if (it != _memory.end()) {
+				program = it->second;
+				return true;
+			}
+		}
+		if (_directory.empty() || !loadEntry(key, program)) {
+			return false;
+		}
+		keepInMemory(key, program);
+		return true;
+	}
+	
+	bool BuildCache::storeProgram(const Key & key, const Program & program) const
+	{
+		keepInMemory(key, program);
+		return _directory.empty() || storeEntry(key, program);
+	}
+	
+	// MARK: - Private
+	
+	bool BuildCache::loadEntry(const Key & key, Program & program) const
+	{
+		SourceBinaryFile file(Path(entryPath(key)));
+		if (!file.isValid()) {
+			return false;
+		}
+		EntryReader reader(file.bytes());
+		char magic[sizeof(ENTRY_MAGIC)];
+		byte version;
+		Key stored_key;
+		U64 autostart;
+		ByteRange bytes;
+		U32 messages_count;
+		if (!reader.readBytes(magic, sizeof(magic)) || memcmp(magic, ENTRY_MAGIC, sizeof(magic)) != 0 ||
+			!reader.readBytes(&version, 1) || version != ENTRY_VERSION ||
+			!reader.readU64(stored_key.hash[0]) || !reader.readU64(stored_key.hash[1]) ||
+			stored_key.hash[0] != key.hash[0] || stored_key.hash[1] != key.hash[1] ||
+			!reader.readU64(autostart) || !reader.readRange(bytes) || !reader.readU32(messages_count)) {
+			return false;
+		}
+		std::vector<BufferedErrorLogger::Message> messages;
+		for (U32 i = 0; i < messages_count; i++) {
+			BufferedErrorLogger::Message message;
+			byte severity;
+			U32 line, column;
+			if (!reader.readBytes(&severity, 1) || severity > ErrorLogging::SevDebug ||
+				!reader.readU32(line) || !reader.readU32(column) ||
+				!reader.readString(message.info.sourceFile) || !reader.readString(message.message)) {
+				return false;
+			}
+			message.severity = ErrorLogging::Severity(severity);
+			message.info.line = line;
+			message.info.column = column;
+			messages.push_back(std::move(message));
+		}
+		if (!reader.atEnd()) {
+			return false;
+		}
+		program.bytes.assign(bytes);
+		program.autostartLine = long(int64_t(autostart));
+		program.messages = std::move(messages);
+		return true;
+	}
+	
+	bool BuildCache::storeEntry(const Key & key, const Program & program) const
+	{
+		ByteArray entry;
+		entry.reserve(64 + program.bytes.size());
+		entry.append(reinterpret_cast<const byte*>(ENTRY_MAGIC), sizeof(ENTRY_MAGIC));
+		entry.append(ENTRY_VERSION);
+		WriteU64(entry, key.hash[0]);
+		WriteU64(entry, key.hash[1]);
+		WriteU64(entry, U64(int64_t(program.autostartLine)));
+		WriteU32(entry, U32(program.bytes.size()));
+		entry.append(program.bytes.byteRange());
+		WriteU32(entry, U32(program.messages.size()));
+		for (auto && message: program.messages) {
+			entry.append(byte(message.severity));
+			WriteU32(entry, U32(message.info.line));
+			WriteU32(entry, U32(message.info.column));
+			WriteString(entry, message.info.sourceFile);
+			WriteString(entry, message.message);
+		}
+		
+		// Write to a temporary file first, so readers never see an incomplete entry.
+		std::error_code error;
+		std::filesystem::create_directories(_directory, error);
+		if (error) {
+			return false;
+		}
+		const auto path = entryPath(key);
+		const auto temporary_path = path + ".tmp." + std::to_string(ProcessId()) + "." + std::to_string(s_temporaryFileId.fetch_add(1));
+		FILE * file = fopen(temporary_path.c_str(), "wb");
+		if (!file) {
+			return false;
+		}
+		bool result = fwrite(entry.data(), 1, entry.size(), file) == entry.size();
+		result = (fclose(file) == 0) && result;
+		if (result) {
+			// Unlike `rename()`, this replaces an existing entry on all platforms.
+			std::filesystem::rename(temporary_path, path, error);
+			result = !error;
+		}
+		if (!result) {
+			remove(temporary_path.c_str());
+		}
+		return result;
+	}
+	
+	void BuildCache::keepInMemory(const Key & key, const Program & program) const
+	{
+		std::lock_guard<std::mutex> lock(_memoryMutex);
+		if (_memorySize + program.bytes.size() > MEMORY_LIMIT) {
+			_memory.clear();
+			_memorySize = 0;
+		}
+		auto result = _memory.emplace(std::make_pair(key.hash[0], key.hash[1]), program);
+		if (result.second) {
+			_memorySize += program.bytes.size();
+		}
+	}
+	
+	std::string BuildCache::entryPath(const Key & key) const
+	{
+		return _directory + Path::directorySeparator + key.toString() + ".bpc";
+	}
+	
+} // bastapir
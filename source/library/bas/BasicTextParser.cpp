@@ -16,6 +16,10 @@
 
 #include <bastapir/bas/BasicTextParser.h>
 #include "Double2Speccy.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <charconv>
 
 namespace bastapir
 {
@@ -50,11 +54,11 @@ namespace bas
 	{
 		bool result = true;
 		
-		_constants.clear();
+		_symbols.clear();
 		for (auto && c: constants) {
-			if (_constants.find(c.name) == _constants.end()) {
+			if (_symbols.find(c.name) == SymbolTable::NotFound) {
 				if (c.isResolved) {
-					_constants[c.name] = c;
+					_symbols.symbol(_symbols.intern(c.name)).setValue(c.value);
 				} else {
 					// Variable has no value.
 					_log->error(errInfo(), "Constant `" + c.name + "` injected into BASIC has no value assigned.");
@@ -65,34 +69,47 @@ namespace bas
 				_log->warning(errInfo(), "Constant `" + c.name + "` injected into BASIC source already exists. Ignoring new value.");
 			}
 		}
+		_constantsCount = _symbols.size();
 		return result;
 	}
 	
-	std::tuple<bool, std::string> BasicTextParser::resolveVariable(const std::string & variable_name) const
+	std::tuple<bool, std::string> BasicTextParser::resolveVariable(std::string_view variable_name) const
 	{
-		auto var = findVariable(variable_name);
-		if (var && var->isResolved) {
-			return std::make_tuple(true, var->value);
+		auto id = _symbols.find(variable_name);
+		if (id != SymbolTable::NotFound) {
+			auto & symbol = _symbols.symbol(id);
+			if (symbol.isResolved) {
+				return std::make_tuple(true, symbol.value);
+			}
 		}
 		return std::make_tuple(false, "");
 	}
 	
-	bool BasicTextParser::parse(const std::string & source, const SourceFileInfo & source_info, Keywords::Dialect dialect)
+	bool BasicTextParser::parse(std::string_view source, const SourceFileInfo & source_info, Keywords::Dialect dialect)
+	{
+		return parse(source, source_info, std::make_shared<LineIndex>(source.data(), source.data() + source.size()), dialect);
+	}
+	
+	bool BasicTextParser::parse(const SourceTextFile & file, Keywords::Dialect dialect)
+	{
+		return parse(file.string(), file.info(), file.lineIndex(), dialect);
+	}
+	
+	bool BasicTextParser::parse(std::string_view source, const SourceFileInfo & source_info, std::shared_ptr<const LineIndex> line_index, Keywords::Dialect dialect)
 	{
 		// Prepare internal structures
 		_sourceFileInfo = source_info;
 		_tokenizer.setStopAtLineEnd(true);
-		_tokenizer.resetTo(source.begin(), source.end());
+		_tokenizer.resetTo(Tokenizer::Range { source.data(), source.data() + source.size() }, line_index);
 		_keywords.setDialect(dialect);
 		
-		// Clear variables & validate constants
-		_variables.clear();
-		for (auto && c: _constants) {
-			if (!c.second.isResolved) {
-				_log->error(errInfo(), "Constant `" + c.first + "` injected into BASIC has unresolved value.");
-				return false;
-			}
+		// Clear variables, but keep constants. All constants are resolved in `setConstants()`.
+		_symbols.truncate(_constantsCount);
+		for (size_t id = 0; id < _constantsCount; id++) {
+			_symbols.symbol(static_cast<SymbolTable::SymbolID>(id)).references = 0;
 		}
+		_numberCacheGeneration++;
+		_statistics = Statistics();
 		// Let's parse that string!!
 		return doParse();
 	}
@@ -101,27 +118,60 @@ namespace bas
 		return _output;
 	}
 	
+	ByteArray BasicTextParser::releaseProgramBytes() {
+		ByteArray result = std::move(_output);
+		_output.clear();
+		return result;
+	}
 	
-	// MARK: - Matching functions -
-	
-	static int match_VariableName(int c)
-	{
-		if (isalnum(c)) {
-			return true;
-		}
-		return false;
+	const BasicTextParser::Statistics & BasicTextParser::statistics() const {
+		return _statistics;
 	}
 	
+	
+	// MARK: - Matching & parsing functions -
+	
 	static int match_BinaryNumber(int c)
 	{
 		return c == '1' || c == '0';
 	}
 	
-	static int match_HexadecimalNumber(int c)
-	{
-		return (c >= '0' && c <= '9') ||
-				(c >= 'a' && c <= 'f') ||
-				(c >= 'A' && c <= 'F');
+	/// Parses whole |text| as unsigned integer in given |base|. Returns false if text is not
+	/// a number, or if the number doesn't fit to 32 bits.
+	static bool parseInteger(std::string_view text, int base, U32 & value)
+	{
+		auto result = std::from_chars(text.data(), text.data() + text.size(), value, base);
+		return result.ec == std::errc() && result.ptr == text.data() + text.size();
+	}
+	
+	/// Parses floating point number from |text|. Unlike `std::stod()`, the function doesn't
+	/// allocate memory. Returns false if text is not a number, or if the number is out of range.
+	static bool parseDouble(std::string_view text, double & value)
+	{
+		// Note that the text may end with an exponent character without digits. Both
+		// implementations below ignore such character, like `std::stod()` did.
+	#if defined(__cpp_lib_to_chars)
+		auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+		return result.ec == std::errc();
+	#else
+		// Fallback for standard libraries without floating point `from_chars()`. The number
+		// must be NUL terminated, so typical numbers are copied to a local buffer.
+		char buffer[64];
+		std::string long_text;
+		const char * str;
+		if (text.size() < sizeof(buffer)) {
+			memcpy(buffer, text.data(), text.size());
+			buffer[text.size()] = 0;
+			str = buffer;
+		} else {
+			long_text = std::string(text);
+			str = long_text.c_str();
+		}
+		char * end;
+		errno = 0;
+		value = strtod(str, &end);
+		return end != str && errno != ERANGE;
+	#endif
 	}
 	
 	
@@ -129,10 +179,21 @@ namespace bas
 	
 	bool BasicTextParser::doParse()
 	{
-		for (U16 pass = 1; pass <= 2; ++pass) {
+		// In single-pass mode, the whole program is processed in pass 0.
+		const U16 first_pass = _options.singlePass ? 0 : 1;
+		const U16 last_pass  = _options.singlePass ? 0 : 2;
+		for (U16 pass = first_pass; pass <= last_pass; ++pass) {
+			// Allocate the output only once. In two-pass mode, the exact size is known after the first
+			// pass. In single-pass mode, the size is estimated from the source. Keywords make the
+			// program shorter, but each number adds 6 bytes of its binary form.
+			const size_t expected_size = pass == 2 ? countedProgramSize() : _tokenizer.lineIndex()->bufferSize() * 5 / 4;
 			// Prepare CTX
 			_ctx = makeContext(pass);
 			_output.clear();
+			if (_ctx.isWriting()) {
+				_output.reserve(expected_size);
+			}
+			_fixups.clear();
 			_tokenizer.reset();
 			//
 			while (true) {
@@ -144,24 +205,35 @@ namespace bas
 				}
 			}
 			//
-			if (pass == 1) {
+			if (_ctx.isDeclaring()) {
 				if (isAllVariablesResolved(true) == false) {
 					return false;
 				}
-			} else {
-				if (_ctx.processedLines == 0) {
-					_log->error(errInfo(), "BASIC program is empty.");
-					return false;
-				}
-				if (_output.empty()) {
-					_log->error(errInfo(), "No bytes were generated from BASIC program.");
+			}
+			if (_ctx.isWriting()) {
+				if (!applyFixups()) {
 					return false;
 				}
+				assert(pass != 2 || _output.size() == expected_size);
+				return doValidateProgram();
 			}
 		}
 		return true;
 	}
 	
+	bool BasicTextParser::doValidateProgram()
+	{
+		if (_ctx.processedLines == 0) {
+			_log->error(errInfo(), "BASIC program is empty.");
+			return false;
+		}
+		if (_output.empty()) {
+			_log->error(errInfo(), "No bytes were generated from BASIC program.");
+			return false;
+		}
+		return true;
+	}
+	
 	
 	bool BasicTextParser::doParseLine()
 	{
@@ -203,7 +275,7 @@ namespace bas
 			}
 			
 			// #### Numbers
-			if (isnumber(c)) {
+			if (isdigit(c)) {
 				if (is_line_begin) {
 					if (!doParseLineNumber()) {
 						return false;
@@ -263,7 +335,11 @@ namespace bas
 			_log->error(errInfoLC(), "Wrong line number.");
 			return false;
 		}
-		int number = std::stoi(line_range.content());
+		U32 number;
+		if (!parseInteger(line_range.view(), 10, number) || number > 9999) {
+			_log->error(errInfoLC(), "Line number `" + line_range.content() + "` is out of allowed range (1 to 9999).");
+			return false;
+		}
 		return writeLineNumber(number, false);
 	}
 	
@@ -283,12 +359,12 @@ namespace bas
 					_log->error(errInfoLC(), "Invalid hexadecimal number.");
 					return false;
 				}
-				int number = std::stoi(hexadecimal.content(), nullptr, 16);
-				if (number > 0xFFFF) {
+				U32 number;
+				if (!parseInteger(hexadecimal.view(), 16, number) || number > 0xFFFF) {
 					_log->error(errInfoLC(), "Hexadecimal number is too big.");
 					return false;
 				}
-				return writeNumber((double)number, std::to_string(number));
+				return writeInteger(number);
 				
 			} else if (c2 == 'b' || c2 == 'B' || as_binary) {
 				// 0b... or 0B... or direct request for binary number
@@ -300,14 +376,14 @@ namespace bas
 					_log->error(errInfoLC(), "Invalid binary number.");
 					return false;
 				}
-				int number = std::stoi(binary.content(), nullptr, 2);
-				if (number > 0xFFFF) {
+				U32 number;
+				if (!parseInteger(binary.view(), 2, number) || number > 0xFFFF) {
 					_log->error(errInfoLC(), "Binary number is too big.");
 					return false;
 				}
 				// As an optimization, we completely ignore binary numbers and write
 				// them as regular numbers.
-				return writeNumber((double)number, std::to_string(number));
+				return writeInteger(number);
 			}
 		}
 			
@@ -315,28 +391,27 @@ namespace bas
 		_tokenizer.resetCapture();
 		if (c1 != '.') {
 			// IIII
-			_tokenizer.skipWhile(isnumber);
+			_tokenizer.skipDigits();
 		}
 		c1 = _tokenizer.charAt();
 		if (c1 == '.') {
 			// .FFF
 			_tokenizer.movePosition();
-			_tokenizer.skipWhile(isnumber);
+			_tokenizer.skipDigits();
 		}
 		c1 = _tokenizer.charAt();
 		if (c1 == 'E' || c1 == 'e') {
 			// eMMM or EMMM
 			_tokenizer.movePosition();
-			_tokenizer.skipWhile(isnumber);
+			_tokenizer.skipDigits();
 		}
-		auto any_number = _tokenizer.capture();
-		if (any_number.empty()) {
+		auto any_number = _tokenizer.capture().view();
+		// The mantissa must contain at least one digit, so "." or ".E5" is not a number.
+		if (any_number.empty() || !(isdigit(any_number[0]) || (any_number.size() > 1 && isdigit(any_number[1])))) {
 			_log->error(errInfoLC(), "Invalid number.");
 			return false;
 		}
-		auto textual_repr = any_number.content();
-		double number = std::stod(textual_repr);
-		return writeNumber(number, textual_repr);
+		return writeNumber(any_number);
 	}
 	
 	
@@ -344,7 +419,7 @@ namespace bas
 	{
 		// Start of label or variable? Skip `@` at first...
 		_tokenizer.movePosition();
-		auto variable_name = captureVariableName().content();
+		auto variable_name = captureVariableName().view();
 		if (is_line_begin) {
 			if (_tokenizer.getChar() != ':') {
 				_log->error(errInfoLC(), "Invalid symbolic line number.");
@@ -360,35 +435,34 @@ namespace bas
 			return false;
 		}
 		
-		if (_ctx.pass == 1) {
-			// first pass, we're declaring stuff
-			auto variable = Variable::variable(variable_name);
-			if (is_line_begin) {
+		if (is_line_begin) {
+			if (_ctx.isDeclaring()) {
 				// This is line number, we need to generate a next number & mark that
 				// next real line should not increase line number.
-				variable.setValue(std::to_string(currentBasicLineNumber()));
+				return declareLineNumber(variable_name);
 			}
-			// Register variable.
-			if (!addVariable(variable, true)) {
-				return false;
+			// 2nd pass, we already have value for this variable. So, do nothing.
+			return true;
+		}
+		if (!_ctx.isWriting()) {
+			// First pass, just register the referenced variable.
+			_symbols.symbol(_symbols.intern(variable_name)).references++;
+			return true;
+		}
+		// Resolve variable. Currently only numeric variables are supported.
+		auto id = _ctx.isDeclaring() ? _symbols.intern(variable_name) : _symbols.find(variable_name);
+		if (id != SymbolTable::NotFound) {
+			if (_symbols.symbol(id).isResolved) {
+				return writeSymbol(id);
 			}
-		} else {
-			// 2nd pass is different. We need to use stored variables.
-			if (is_line_begin) {
-				// We already have value for this variable. So, do nothing.
-			} else {
-				// Resolve variable. Currently only numeric variables are supported.
-				bool resolved; std::string value;
-				std::tie(resolved, value) = resolveVariable(variable_name);
-				if (!resolved) {
-					_log->error(errInfoLC(), "Unable to resolve value of variable `" + variable_name + "`. This looks like an internal error :(");
-					return false;
-				}
-				double dbl_value = std::stod(value);
-				return writeNumber(dbl_value, value);
+			if (_ctx.isDeclaring()) {
+				// Single-pass mode, this is forward reference to symbol declared later.
+				addFixup(id);
+				return true;
 			}
 		}
-		return true;
+		_log->error(errInfoLC(), "Unable to resolve value of variable `" + std::string(variable_name) + "`. This looks like an internal error :(");
+		return false;
 	}
 	
 	
@@ -399,6 +473,8 @@ namespace bas
 		_tokenizer.movePosition();
 		
 		while (true) {
+			// Skip all regular characters at once, then handle the special one.
+			_tokenizer.skipStringCharacters();
 			char c1 = _tokenizer.getChar();
 			if (0 == c1) {
 				// End of line / End of file and string has not been closed.
@@ -425,7 +501,7 @@ namespace bas
 				}
 				// Go back in string, we don't want to capture `\`
 				_tokenizer.movePosition(-1);
-				writeRange(MakeRange(_tokenizer.capture().content()));
+				writeRange(MakeRange(_tokenizer.capture().view()));
 				_tokenizer.movePosition(1 + captured_size);
 				_tokenizer.resetCapture();
 				// Write translated bytek
@@ -434,7 +510,7 @@ namespace bas
 			}
 		}
 		// Write captured region and return with success
-		writeRange(MakeRange(_tokenizer.capture().content()));
+		writeRange(MakeRange(_tokenizer.capture().view()));
 		return true;
 	}
 	
@@ -491,7 +567,7 @@ namespace bas
 			
 		} else if (isalpha(c)) {
 			// Not a keyword, but regular character. Try to match regular BASIC variable
-			writeRange(MakeRange(captureVariableName().content()));
+			writeRange(MakeRange(captureVariableName().view()));
 			return true;
 			
 		} else {
@@ -538,7 +614,7 @@ namespace bas
 			} else if (isalnum(c)) {
 				// Try to match whole words
 				was_space = false;
-				writeRange(MakeRange(captureVariableName().content()));
+				writeRange(MakeRange(captureVariableName().view()));
 			
 			} else {
 				was_space = false;
@@ -558,21 +634,21 @@ namespace bas
 	Tokenizer::Range BasicTextParser::captureNumber()
 	{
 		_tokenizer.resetCapture();
-		_tokenizer.skipWhile(isnumber);
+		_tokenizer.skipDigits();
 		return _tokenizer.capture();
 	}
 
 	Tokenizer::Range BasicTextParser::captureVariableName()
 	{
 		_tokenizer.resetCapture();
-		_tokenizer.skipWhile(match_VariableName);
+		_tokenizer.skipAlphanumeric();
 		return _tokenizer.capture();
 	}
 	
 	Tokenizer::Range BasicTextParser::captureHexadecimalNumber()
 	{
 		_tokenizer.resetCapture();
-		_tokenizer.skipWhile(match_HexadecimalNumber);
+		_tokenizer.skipHexDigits();
 		return _tokenizer.capture();
 	}
 
@@ -588,7 +664,8 @@ namespace bas
 	
 	void BasicTextParser::writeByte(byte b)
 	{
-		if (_ctx.pass > 1) {
+		_ctx.outputSize++;
+		if (_ctx.isWriting()) {
 			_output.push_back(b);
 			//printf(">>> %02x    %lu\n", b, _output.size());
 		}
@@ -596,7 +673,8 @@ namespace bas
 	
 	void BasicTextParser::writeRange(const ByteRange & range)
 	{
-		if (_ctx.pass > 1) {
+		_ctx.outputSize += range.size();
+		if (_ctx.isWriting()) {
 			_output.append(range);
 			//printf(">>> ");
 			//for (auto b: range) {
@@ -649,16 +727,13 @@ namespace bas
 		_ctx.basicLineNumber = line_number + _options.lineNumberIncrement;
 		_ctx.processedLines++;
 		
-		// Serialize line number...
-		if (_ctx.pass > 1) {
-			// Write 16bits line number in BE. We have to also make space for line length, which will be updated
-			// later in `writeLastLineBytes`.
-			byte line_bytes[4] = { (byte)(line_number >> 8), (byte)(line_number & 0xff), 0, 0 };
-			writeRange(MakeRange(line_bytes));
-			// Capture point, where we need to write back size of this just started line
-			_ctx.beginLineBytesOffset = _output.size();
-			_ctx.lineContainsBytes = true;
-		}
+		// Serialize line number. Write 16bits line number in BE. We have to also make space for line length,
+		// which will be updated later in `writeLastLineBytes`.
+		byte line_bytes[4] = { (byte)(line_number >> 8), (byte)(line_number & 0xff), 0, 0 };
+		writeRange(MakeRange(line_bytes));
+		// Capture point, where we need to write back size of this just started line
+		_ctx.beginLineBytesOffset = _ctx.outputSize;
+		_ctx.lineContainsBytes = true;
 		return true;
 	}
 	
@@ -670,7 +745,7 @@ namespace bas
 			// Update line size
 			auto end_last_line = _output.size();
 			auto begin_last_line = _ctx.beginLineBytesOffset;
-			if (end_last_line > 0 && begin_last_line >= 4) {
+			if (_ctx.isWriting() && end_last_line > 0 && begin_last_line >= 4) {
 				U16 line_size = end_last_line - begin_last_line;
 				// we need to update size of current line. `writeLineNumber` function reserved
 				// two bytes at the beginning of the line which has to be updated.
@@ -682,103 +757,252 @@ namespace bas
 		return true;
 	}
 	
-	bool BasicTextParser::writeNumber(double n, const std::string & textual_representation)
+	bool BasicTextParser::writeNumber(std::string_view textual_representation)
 	{
-		int exponent;
-		long mantissa;
-		if (!dbl2spec(n, exponent, mantissa)) {
+		_ctx.outputSize += serializedNumberSize(textual_representation);
+		if (!_ctx.isWriting()) {
+			return true;
+		}
+		NumberBytes number_bytes;
+		if (!encodeNumber(textual_representation, number_bytes)) {
 			_log->error(errInfoLC(), "Exponent is out of range (number is too big)");
 			return false;
 		}
-		
+		serializeNumber(textual_representation, number_bytes, _output);
+		return true;
+	}
+	
+	bool BasicTextParser::writeInteger(U32 value)
+	{
+		// Format number to a local buffer, to avoid temporary string.
+		char buffer[16];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		return writeNumber(std::string_view(buffer, result.ptr - buffer));
+	}
+	
+	void BasicTextParser::serializeNumber(std::string_view textual_representation, const NumberBytes & number_bytes, ByteArray & out) const
+	{
+		if (!_options.shadowNumbers) {
+			out.append(MakeRange(textual_representation));
+		} else {
+			out.push_back('0');
+		}
+		out.insert(out.end(), number_bytes.begin(), number_bytes.end());
+	}
+	
+	void BasicTextParser::serializeNumber(std::string_view textual_representation, const NumberBytes & number_bytes, byte * out) const
+	{
 		// Write textual representation
 		if (!_options.shadowNumbers) {
 			// For regular processing write just available string representation.
-			writeRange(MakeRange(textual_representation));
+			memcpy(out, textual_representation.data(), textual_representation.size());
+			out += textual_representation.size();
 		} else {
 			// For "shadow" number just write zero character and keep its binary representation.
 			// This makes BASIC shorter and still runable, but uneditable by ZX Spectrum.
-			writeByte('0');
+			*out++ = '0';
 		}
 		
 		// Write binary representation
-		byte b_repr[6];
-		b_repr[0] = Keywords::Code_NUM;
-		b_repr[1] = exponent;
-		b_repr[2] = (mantissa >> 24) & 0xFF;
-		b_repr[3] = (mantissa >> 16) & 0xFF;
-		b_repr[4] = (mantissa >> 8 ) & 0xFF;
-		b_repr[5] =  mantissa        & 0xFF;
-		writeRange(MakeRange(b_repr));
-		
-		return true;
+		memcpy(out, number_bytes.data(), number_bytes.size());
 	}
 	
-	// MARK: - Variable management
+	size_t BasicTextParser::serializedNumberSize(std::string_view textual_representation) const
+	{
+		const size_t text_size = _options.shadowNumbers ? 1 : textual_representation.size();
+		return text_size + std::tuple_size<NumberBytes>::value;
+	}
+	
+	size_t BasicTextParser::countedProgramSize() const
+	{
+		// Bytes were counted in the first pass, except references to symbols, which
+		// had no value yet.
+		size_t size = _ctx.outputSize;
+		for (size_t id = 0; id < _symbols.size(); id++) {
+			auto & symbol = _symbols.symbol(static_cast<SymbolTable::SymbolID>(id));
+			size += symbol.references * serializedNumberSize(symbol.value);
+		}
+		return size;
+	}
 	
-	const BasicTextParser::Variable * BasicTextParser::findVariable(const std::string & name) const
+	bool BasicTextParser::writeSymbol(SymbolTable::SymbolID id)
 	{
-		auto it = _constants.find(name);
-		if (it != _constants.end()) {
-			return &it->second;
+		_ctx.outputSize += serializedNumberSize(_symbols.symbol(id).value);
+		if (!_ctx.isWriting()) {
+			return true;
 		}
-		it = _variables.find(name);
-		if (it != _variables.end()) {
-			return &it->second;
+		if (!encodeSymbol(id)) {
+			_log->error(errInfoLC(), "Exponent is out of range (number is too big)");
+			return false;
 		}
-		return nullptr;
+		auto & symbol = _symbols.symbol(id);
+		serializeNumber(symbol.value, symbol.number, _output);
+		return true;
 	}
 	
-	BasicTextParser::Variable * BasicTextParser::findVariable(const std::string & name)
+	bool BasicTextParser::encodeSymbol(SymbolTable::SymbolID id)
 	{
-		auto it = _constants.find(name);
-		if (it != _constants.end()) {
-			return &it->second;
+		auto & symbol = _symbols.symbol(id);
+		if (!symbol.isEncoded) {
+			if (!encodeNumber(symbol.value, symbol.number)) {
+				return false;
+			}
+			symbol.isEncoded = true;
 		}
-		it = _variables.find(name);
-		if (it != _variables.end()) {
-			return &it->second;
+		return true;
+	}
+	
+	/// Number of entries in number cache. Must be power of two.
+	static const size_t NUMBER_CACHE_SIZE = 512;
+	
+	bool BasicTextParser::encodeNumber(std::string_view textual_representation, NumberBytes & out)
+	{
+		const size_t length = textual_representation.size();
+		const char * text = textual_representation.data();
+		
+		// Integers up to 65535 are the most common numbers in programs. Their binary
+		// form is trivial, so it's faster to encode them directly than to use the cache.
+		if (length > 0 && length <= 5) {
+			U32 value = 0;
+			size_t i = 0;
+			for (; i < length && text[i] >= '0' && text[i] <= '9'; i++) {
+				value = value * 10 + (text[i] - '0');
+			}
+			if (i == length && value <= 0xFFFF) {
+				_statistics.smallIntegers++;
+				out = NumberBytes { Keywords::Code_NUM, 0, 0, (byte)(value & 0xFF), (byte)(value >> 8), 0 };
+				return true;
+			}
 		}
-		return nullptr;
+		
+		// Other numbers are looked up in the cache, keyed by their textual representation.
+		NumberCacheEntry * entry = nullptr;
+		if (length <= sizeof(entry->text)) {
+			if (_numberCache.empty()) {
+				_numberCache.resize(NUMBER_CACHE_SIZE, NumberCacheEntry());
+			}
+			// FNV-1a hash
+			U32 hash = 2166136261u;
+			for (size_t i = 0; i < length; i++) {
+				hash = (hash ^ (byte)text[i]) * 16777619u;
+			}
+			entry = &_numberCache[hash & (NUMBER_CACHE_SIZE - 1)];
+			if (entry->generation == _numberCacheGeneration && entry->length == length && memcmp(entry->text, text, length) == 0) {
+				_statistics.numberCacheHits++;
+				out = entry->bytes;
+				return true;
+			}
+		}
+		_statistics.numberCacheMisses++;
+		
+		double value;
+		int exponent;
+		long mantissa;
+		if (!parseDouble(textual_representation, value) || !dbl2spec(value, exponent, mantissa)) {
+			return false;
+		}
+		out[0] = Keywords::Code_NUM;
+		out[1] = exponent;
+		out[2] = (mantissa >> 24) & 0xFF;
+		out[3] = (mantissa >> 16) & 0xFF;
+		out[4] = (mantissa >> 8 ) & 0xFF;
+		out[5] =  mantissa        & 0xFF;
+		
+		if (entry) {
+			// Replace whatever was stored in the slot.
+			entry->generation = _numberCacheGeneration;
+			entry->length = static_cast<U8>(length);
+			memcpy(entry->text, text, length);
+			entry->bytes = out;
+		}
+		return true;
 	}
 	
-	bool BasicTextParser::addVariable(const Variable & var, bool is_line_number)
+	void BasicTextParser::addFixup(SymbolTable::SymbolID id)
 	{
-		auto current = findVariable(var.name);
-		if (current != nullptr) {
-			if (current->isResolved) {
-				// Current is already resolved
-				if (var.isResolved) {
-					// If new one is also resolved, this means that we have duplicit symbol.
-					if (is_line_number) {
-						_log->error(errInfoLC(), "Duplicit symbolic line number `" + var.name + "` detected in BASIC file.");
-					} else {
-						_log->error(errInfoLC(), "Duplicit variable `" + var.name + "` injected into BASIC.");
-					}
-					return false;
-				}
-			} else {
-				// current is not resolved, but if new one has value, then
-				// we can update value of already stored one.
-				if (var.isResolved) {
-					current->setValue(var.value);
-				}
+		Fixup fixup;
+		fixup.symbol = id;
+		fixup.offset = _output.size();
+		fixup.beginLineBytesOffset = _ctx.lineContainsBytes ? _ctx.beginLineBytesOffset : 0;
+		_fixups.push_back(fixup);
+	}
+	
+	bool BasicTextParser::applyFixups()
+	{
+		if (_fixups.empty()) {
+			return true;
+		}
+		// At first, encode all referenced symbols and calculate the final size of program. Each
+		// inserted number also makes its line longer, so the line size, already written in
+		// `writeLastLineBytes`, has to be updated. The size is still at its original offset.
+		size_t inserted_size = 0;
+		for (auto && fixup: _fixups) {
+			auto & symbol = _symbols.symbol(fixup.symbol);
+			if (!symbol.isResolved) {
+				_log->error(errInfo(), "Unable to resolve value of variable `" + symbol.name + "`. This looks like an internal error :(");
+				return false;
 			}
-		} else {
-			// New variable, store to database
-			_variables[var.name] = var;
+			if (!encodeSymbol(fixup.symbol)) {
+				_log->error(errInfo(), "Exponent is out of range (number is too big)");
+				return false;
+			}
+			const size_t number_size = serializedNumberSize(symbol.value);
+			if (fixup.beginLineBytesOffset >= 4) {
+				const size_t size_offset = fixup.beginLineBytesOffset - 2;
+				U16 line_size = _output.at(size_offset) | (_output.at(size_offset + 1) << 8);
+				line_size += number_size;
+				_output.at(size_offset)     =  line_size       & 0xFF;
+				_output.at(size_offset + 1) = (line_size >> 8) & 0xFF;
+			}
+			inserted_size += number_size;
+		}
+		// Fixups are sorted by offset, so the program can be re-assembled in place, in one sweep
+		// from its end. Each block of bytes is moved only once, directly to its final position.
+		size_t source_end = _output.size();
+		size_t target_end = source_end + inserted_size;
+		_output.resize(target_end);
+		byte * bytes = _output.data();
+		for (auto it = _fixups.rbegin(); it != _fixups.rend(); ++it) {
+			const size_t length = source_end - it->offset;
+			target_end -= length;
+			memmove(bytes + target_end, bytes + it->offset, length);
+			auto & symbol = _symbols.symbol(it->symbol);
+			target_end -= serializedNumberSize(symbol.value);
+			serializeNumber(symbol.value, symbol.number, bytes + target_end);
+			source_end = it->offset;
+		}
+		assert(source_end == target_end);
+		_fixups.clear();
+		return true;
+	}
+	
+	// MARK: - Variable management
+	
+	bool BasicTextParser::declareLineNumber(std::string_view name)
+	{
+		auto & symbol = _symbols.symbol(_symbols.intern(name));
+		if (symbol.isResolved) {
+			_log->error(errInfoLC(), "Duplicit symbolic line number `" + symbol.name + "` detected in BASIC file.");
+			return false;
 		}
+		// Line number is always a small integer, so its binary form is prepared immediately
+		// and references to the symbol are just copied to the output.
+		char buffer[8];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), currentBasicLineNumber());
+		symbol.setValue(std::string_view(buffer, result.ptr - buffer));
+		symbol.isEncoded = encodeNumber(symbol.value, symbol.number);
 		return true;
 	}
 	
 	bool BasicTextParser::isAllVariablesResolved(bool dump_error) const
 	{
 		bool result = true;
-		for (auto && var: _variables) {
-			if (!var.second.isResolved) {
+		for (size_t id = _constantsCount; id < _symbols.size(); id++) {
+			auto & symbol = _symbols.symbol(static_cast<SymbolTable::SymbolID>(id));
+			if (!symbol.isResolved) {
 				result = false;
 				if (dump_error) {
-					_log->error(errInfo(), "Variable `" + var.first + "` injected into BASIC has unresolved value.");
+					_log->error(errInfo(), "Variable `" + symbol.name + "` injected into BASIC has unresolved value.");
 				} else {
 					break;
 				}
@@ -23,15 +23,19 @@
 
 #include "Double2Speccy.h"
 #include <math.h>
+#include <string.h>
+#include <limits>
 
 namespace bastapir
 {
 namespace bas
 {
+	static_assert(std::numeric_limits<double>::is_iec559, "IEEE-754 double is required");
+	
 	bool dbl2spec(double num, int & exp, long & man)
 	{
 		// check for small integers
-		if (num == (long)num && num >= -65535.0 && num <= 65535.0)
+		if (num >= -65535.0 && num <= 65535.0 && num == (long)num)
 		{
 			// ignores sign - see below, which applies to ints too.
 			long tmp = (long)fabs(num);
@@ -45,62 +49,47 @@ namespace bas
 			// '-' character to detemine negativity - tests confirm this.
 			// As such, we *completely ignore* the sign of the number.
 			// exp is 0x80+exponent.
-			num = fabs(num);
-			
-			// binary standard form goes from 0.50000... to 0.9999...(dec), like
-			// decimal which goes from        0.10000... to 0.9999....
 			//
-			// as such, if the number is >=1, it gets divided by 2, and exp++.
-			// And if the number is <0.5, it gets multiplied by 2, and exp--.
+			// The original routine normalized the number to binary standard form,
+			// 0.5 <= num < 1, by repeated halving or doubling, and then rolled 32
+			// mantissa bits off one by one. Both steps are exact, so the result
+			// can be taken directly from IEEE-754 representation instead:
+			//
+			//   num = 1.fraction * 2^(biased - 1023) = 0.1fraction * 2^(biased - 1022)
+			//
+			U64 bits;
+			memcpy(&bits, &num, sizeof(bits));
+			const int biased_exp = static_cast<int>((bits >> 52) & 0x7FF);
+			const U64 fraction   = bits & 0x000FFFFFFFFFFFFFull;
 			
-			exp = 0;
-			while(num >= 1.0)
-			{
-				num /= 2.0;
-				exp++;
-			}
-			while(num < 0.5)
-			{
-				num*=2.0;
-				exp--;
+			if (biased_exp == 0 || biased_exp == 0x7FF) {
+				// Subnormal numbers are far below the supported range. Infinity
+				// and NaN can't be represented at all. (Zero is a small integer.)
+				return false;
 			}
 			
-			// so now the number is in binary standard form in exp and num.
 			// we check the range of exp... -128 <= exp <= 127.
 			// (if outside, we return error (i.e. 0))
 			
-			if (exp < -128 || exp > 127) {
+			const int e = biased_exp - 1022;
+			if (e < -128 || e > 127) {
 				return false;
 			}
+			exp = 128 + e;
 			
-			exp = 128 + exp;
-			
-			// so now all we need to do is roll the bits off the mantissa in `num'.
-			// we start at the 0.5ths bit at bit 0, and shift left 1 each time
-			// round the loop.
-			
-			num *= 2.0; // make it so that the 0.5ths bit is the integer part,
-			// and the rest is the fractional (0.xxx) part.
-			
-			man = 0;
-			for (int f = 0; f < 32; f++)
-			{
-				man <<= 1;
-				man |= (int)num;
-				num -= (int)num;
-				num *= 2.0;
-			}
+			// The mantissa is the implicit 0.5ths bit followed by 31 most
+			// significant bits of fraction.
+			U32 mantissa = 0x80000000 | static_cast<U32>(fraction >> 21);
 			
-			// Now, if (int)num is non-zero (well, 1) then we should generally
-			// round up 1. We don't do this if it would cause an overflow in the
-			// mantissa, though.
+			// Now, if the next bit is 1 then we should generally round up 1.
+			// We don't do this if it would cause an overflow in the mantissa, though.
 			
-			if ((int)num && man != 0xFFFFFFFF) {
-				man++;
+			if (((fraction >> 20) & 1) && mantissa != 0xFFFFFFFF) {
+				mantissa++;
 			}
 			
 			// finally, zero out the top bit
-			man &= 0x7FFFFFFF;
+			man = mantissa & 0x7FFFFFFF;
 		}
 		// done
 		return true;
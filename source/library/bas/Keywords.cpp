@@ -14,8 +14,7 @@
 // limitations under the License.
 //
 
-#include "Keywords.h"
-#include <set>
+#include <bastapir/bas/Keywords.h>
 
 namespace bastapir
 {
@@ -23,46 +22,75 @@ namespace bas
 {
 	// MARK: - Support functions
 	
-	static bool matchString(const std::string & str, Tokenizer::iterator begin, Tokenizer::iterator end)
+	// Returns true if character is a letter. The function is usable at compile time.
+	static constexpr bool isAlphaChar(char c)
 	{
-		for (char c: str) {
-			if (begin == end) {
-				return false;
-			}
-			if (c != *begin++) {
-				return false;
-			}
-		}
-		return true;
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 	}
-
-	// Match string case-insensitive
-	static bool matchStringCI(const std::string & str, Tokenizer::iterator begin, Tokenizer::iterator end)
+	
+	// Returns true if provided keyword contains at least one non-alpha character.
+	// Function is optimized for BASIC keywords (e.g. validates only first and last char)
+	static constexpr bool isSpecialKeyword(const char * keyword)
 	{
-		for (char c: str) {
-			if (begin == end) {
-				return false;
-			}
-			char d = *begin++;
-			if (tolower(c) != tolower(d)) {
-				return false;
-			}
+		if (*keyword == 0) {
+			return false;
+		}
+		const char * last = keyword;
+		while (*(last + 1) != 0) {
+			++last;
 		}
-		return true;
+		return !isAlphaChar(*keyword) || !isAlphaChar(*last);
 	}
 	
-	// Returns true if provided string contains at least one non-alpha character.
-	// Function is optimized for BASIC keywords (e.g. validates only first and last char)
-	static bool findSpecialChar(const std::string & str)
+	
+	// MARK: - Keywords trie
+	
+	//
+	// Keywords are matched with a trie, built at compile time for each BASIC dialect.
+	// Upper and lower case letters lead to the same edge, so the trie is case-insensitive.
+	// Walking the trie visits each input character just once, regardless of the number
+	// of keywords.
+	//
+	
+	/// Number of edges in each trie node. The edge 0 belongs to all characters which
+	/// don't appear in any keyword, and never leads to another node.
+	static constexpr size_t TrieSymbolCount = 32;
+	
+	/// Table translating characters to trie edges.
+	struct TrieSymbols
 	{
-		if (str.begin() != str.end()) {
-			bool first_special = !isalpha(*str.begin());
-			bool last_special  = !isalpha(*(str.end() - 1));
-			return first_special || last_special;
+		byte map[256] = {};
+		
+		constexpr TrieSymbols()
+		{
+			for (int c = 'a'; c <= 'z'; c++) {
+				map[c] = map[c - 'a' + 'A'] = static_cast<byte>(1 + c - 'a');
+			}
+			map[(byte)'$'] = 27;
+			map[(byte)'#'] = 28;
+			map[(byte)'<'] = 29;
+			map[(byte)'='] = 30;
+			map[(byte)'>'] = 31;
 		}
-		return false;
-	}
+		
+		/// Returns edge for character |c|.
+		constexpr byte operator[](char c) const
+		{
+			return map[(byte)c];
+		}
+	};
+	
+	static constexpr TrieSymbols s_trieSymbols;
 	
+	struct KeywordTrieNode
+	{
+		/// Indexes of following nodes, for each edge. Zero means that there's no such node.
+		U16 next[TrieSymbolCount] = {};
+		/// Keyword code, if node terminates a keyword, or 0.
+		byte code = 0;
+		/// If true, keyword contains non-alpha characters, so it doesn't need a separator.
+		bool special = false;
+	};
 	
 	// MARK: - Class implementation
 	
@@ -72,7 +100,8 @@ namespace bas
 	const byte Keywords::Code_ENT = 0x0D;
 	
 	Keywords::Keywords(Dialect dialect) :
-		_dialect(dialect)
+		_dialect(dialect),
+		_keywordTrie(nullptr)
 	{
 		setupStructures(dialect);
 	}
@@ -90,49 +119,39 @@ namespace bas
 	
 	byte Keywords::findKeyword(Tokenizer::iterator begin, Tokenizer::iterator end, size_t & out_matched_size) const
 	{
-		if (begin != end) {
-			// Look if first char is in keywords
-			auto max_distance = std::distance(begin, end);
-			if (_keywordsFirstChars.find(tolower(*begin)) != std::string::npos) {
-				for (auto && kw: _keywords) {
-					if (matchStringCI(kw.keyword, begin, end)) {
-						size_t matched_size = kw.keyword.size();
-						// If a whole special keyword is matched, then we're pretty sure
-						// that a whole keyword is matched.
-						// If there's no special character in the keyword, then we have to
-						// look behind the matched sequence. If there's alphanumeric or underscore,
-						// then this is not a keyword and we have to continue with search.
-						if (!kw.special && max_distance > matched_size) {
-							const char c = *(begin + matched_size);
-							if (isalnum(c) || c == '_') {
-								continue;
-							}
-						}
-						// Matched, return the byte representation & matched size.
-						out_matched_size = matched_size;
-						return kw.code;
-					}
-				}
+		// Walk the trie as far as possible. Each node terminating a keyword is a candidate,
+		// so the last accepted candidate is the longest matching keyword.
+		byte code = 0;
+		size_t node = 0;
+		auto it = begin;
+		while (it != end) {
+			node = _keywordTrie[node].next[s_trieSymbols[*it]];
+			if (node == 0) {
+				break;
 			}
-		}
-		return 0;
-	}
-	
-	byte Keywords::findEscapeCode(Tokenizer::iterator begin, Tokenizer::iterator end, size_t & out_matched_size) const
-	{
-		if (begin != end) {
-			for (auto && sc: _escapeCodes) {
-				if (matchString(sc.sequence, begin, end)) {
-					out_matched_size = sc.sequence.size();
-					return sc.code;
+			++it;
+			const KeywordTrieNode & candidate = _keywordTrie[node];
+			if (candidate.code == 0) {
+				continue;
+			}
+			// If a whole special keyword is matched, then we're pretty sure
+			// that a whole keyword is matched.
+			// If there's no special character in the keyword, then we have to
+			// look behind the matched sequence. If there's alphanumeric or underscore,
+			// then this is not a keyword and we have to continue with search.
+			if (!candidate.special && it != end) {
+				const char c = *it;
+				if (isalnum(c) || c == '_') {
+					continue;
 				}
 			}
+			code = candidate.code;
+			out_matched_size = std::distance(begin, it);
 		}
-		return 0;
+		return code;
 	}
 	
 	
-	
 	// MARK: - Keywords
 	
 	//
@@ -142,7 +161,7 @@ namespace bas
 	// you can type "goto" instead of "go to"
 	//
 	
-	static const char * s_keywordsTable[] =
+	static constexpr const char * s_keywordsTable[] =
 	{
 		"rnd"       ,
 		"inkey$"    ,
@@ -239,50 +258,80 @@ namespace bas
 		nullptr
 	};
 
-	void Keywords::setupStructures(Dialect dialect)
+	/// Trie with all keywords for one BASIC dialect. The |Capacity| parameter defines
+	/// maximum number of nodes.
+	template <size_t Capacity>
+	struct KeywordTrie
 	{
-		// Prepare basic structures
-		_keywords = prepareKeywords(dialect);
-		_escapeCodes = prepareEscapeCodes(dialect);
+		KeywordTrieNode nodes[Capacity] = {};
+		size_t nodesCount = 1;
+		bool valid = true;
 		
-		// Create a set of beginning characters from all keywords.
-		std::set<char> chars;
-		for (auto && keyword: _keywords) {
-			chars.insert(*keyword.keyword.begin());
-		}
-		_keywordsFirstChars.clear();
-		_keywordsFirstChars.reserve(chars.size());
-		for (char c: chars) {
-			_keywordsFirstChars.push_back(c);
+		constexpr KeywordTrie(Keywords::Dialect dialect)
+		{
+			byte code = 0xA5;	// first code - RND
+			for (const char * const * p = s_keywordsTable; *p; ++p) {
+				add(*p, code++);
+			}
+			if (dialect == Keywords::Dialect_128K) {
+				add("spectrum", 0xA3);
+				add("play", 0xA4);
+			}
 		}
-	}
-
-	std::vector<Keywords::Keyword> Keywords::prepareKeywords(Dialect dialect)
-	{
-		byte code = 0xA5;	// first code - RND
-		
-		std::vector<Keyword> table;
-		table.reserve(0x100 - code);
 		
-		const char ** p = s_keywordsTable;
-		while (true) {
-			const char * kw = *p++;
-			if (!kw) {
-				break;
+		constexpr void add(const char * keyword, byte code)
+		{
+			size_t node = 0;
+			for (const char * p = keyword; *p; ++p) {
+				const byte symbol = s_trieSymbols[*p];
+				if (symbol == 0) {
+					// Character is not in symbols table.
+					valid = false;
+					return;
+				}
+				if (nodes[node].next[symbol] == 0) {
+					if (nodesCount == Capacity) {
+						valid = false;
+						return;
+					}
+					nodes[node].next[symbol] = static_cast<U16>(nodesCount++);
+				}
+				node = nodes[node].next[symbol];
+			}
+			if (nodes[node].code != 0) {
+				// Duplicate keyword
+				valid = false;
 			}
-			auto kws = std::string(kw);
-			auto special = findSpecialChar(kws);
-			table.push_back(Keyword { kws, special, code++ });
+			nodes[node].code = code;
+			nodes[node].special = isSpecialKeyword(keyword);
 		}
-		if (dialect == Dialect_128K) {
-			table.push_back(Keyword { "spectrum", false, 0xA3 });
-			table.push_back(Keyword { "play", false, 0xA4 });
+	};
+	
+	// Returns upper bound for number of nodes in any keywords trie.
+	static constexpr size_t maxKeywordTrieNodes()
+	{
+		size_t count = 1 + sizeof("spectrum") + sizeof("play");
+		for (const char * const * p = s_keywordsTable; *p; ++p) {
+			for (const char * c = *p; *c; ++c) {
+				++count;
+			}
 		}
-		// We have to sort keywords table from longer to shorter, to prevent
-		// the shorter keyword be matched as substring to longer ones.
-		// For example, "IN" in "INK"
-		std::sort(table.begin(), table.end(), LongerKeywordPredicate());
-		return table;
+		return count;
+	}
+	
+	// The tries are built twice. The first run calculates exact number of nodes.
+	static constexpr size_t s_trieNodes48K  = KeywordTrie<maxKeywordTrieNodes()>(Keywords::Dialect_48K).nodesCount;
+	static constexpr size_t s_trieNodes128K = KeywordTrie<maxKeywordTrieNodes()>(Keywords::Dialect_128K).nodesCount;
+	
+	static constexpr KeywordTrie<s_trieNodes48K>  s_keywordTrie48K(Keywords::Dialect_48K);
+	static constexpr KeywordTrie<s_trieNodes128K> s_keywordTrie128K(Keywords::Dialect_128K);
+	
+	static_assert(s_keywordTrie48K.valid && s_keywordTrie128K.valid, "Invalid keywords table");
+
+	void Keywords::setupStructures(Dialect dialect)
+	{
+		// All tables are prepared at compile time, so just pick the right one.
+		_keywordTrie = dialect == Dialect_128K ? s_keywordTrie128K.nodes : s_keywordTrie48K.nodes;
 	}
 	
 	// MARK: - Escape codes
@@ -292,7 +341,7 @@ namespace bas
 	// compatible with `zmakebas` program.
 	//
 	
-	static const char * s_EscapeChars[] =
+	static constexpr const char * s_EscapeChars[] =
 	{
 		// Block graphic
 		"  ", " '", "' ", "''", " .", " :", "'.", "':",
@@ -304,26 +353,117 @@ namespace bas
 		nullptr
 	};
 	
-	std::vector<Keywords::EscapeCode> Keywords::prepareEscapeCodes(Dialect dialect)
+	/// String escape sequence and its translated code.
+	struct EscapeCode
+	{
+		const char * sequence = nullptr;	// sequence of characters after backslash.
+		size_t length = 0;					// length of sequence
+		byte code = 0;						// translated code
+	};
+	
+	/// Number of escape codes, including the additional ones.
+	static constexpr size_t escapeCodesCount()
 	{
-		byte code = 0x80;
+		size_t count = 4;
+		for (const char * const * p = s_EscapeChars; *p; ++p) {
+			++count;
+		}
+		return count;
+	}
+	
+	/// Table with all escape codes, in the order of matching.
+	struct EscapeCodesTable
+	{
+		EscapeCode codes[escapeCodesCount()] = {};
 		
-		std::vector<EscapeCode> table;
-		table.reserve(0xA5 - code);
+		constexpr EscapeCodesTable()
+		{
+			byte code = 0x80;
+			size_t index = 0;
+			for (const char * const * p = s_EscapeChars; *p; ++p) {
+				add(index++, *p, code++);
+			}
+			add(index++, "*", 0x7F);	// copyright sign
+			add(index++, "`", 0x60);	// pound sign
+			add(index++, "\\", '\\');	// backslash
+			add(index++, "@", '@');		// @
+		}
 		
-		const char ** p = s_EscapeChars;
-		while (true) {
-			const char * sequence = *p++;
-			if (!sequence) {
-				break;
+		constexpr void add(size_t index, const char * sequence, byte code)
+		{
+			size_t length = 0;
+			while (sequence[length] != 0) {
+				++length;
 			}
-			table.push_back(EscapeCode { sequence, code++ });
+			codes[index] = EscapeCode { sequence, length, code };
+		}
+	};
+	
+	static constexpr EscapeCodesTable s_escapeCodes;
+	
+	static_assert(s_escapeCodes.codes[escapeCodesCount() - 1].code == '@', "Invalid escape codes table");
+	
+	//
+	// Escape sequences are one or two characters long, so all of them can be decoded
+	// with one lookup to table indexed with two characters. Only ASCII characters appear
+	// in sequences, so the table has 128 x 128 entries. Each entry contains code in lower
+	// byte and length of sequence in upper byte, or zero for unknown sequence.
+	//
+	
+	/// Lookup table for escape sequences.
+	struct EscapeLookupTable
+	{
+		U16 entries[128 * 128] = {};
+		bool valid = true;
+		
+		constexpr EscapeLookupTable()
+		{
+			// Fill the table in reverse order, so the sequence which is first in
+			// the codes table wins, exactly as with sequential search.
+			for (size_t i = escapeCodesCount(); i > 0; i--) {
+				const EscapeCode & ec = s_escapeCodes.codes[i - 1];
+				const U16 entry = static_cast<U16>(ec.code | (ec.length << 8));
+				const byte c1 = ec.sequence[0];
+				if (c1 >= 128 || ec.code == 0) {
+					valid = false;
+				} else if (ec.length == 1) {
+					// Single character sequence matches regardless of the following character.
+					for (size_t c2 = 0; c2 < 128; c2++) {
+						entries[c1 * 128 + c2] = entry;
+					}
+				} else if (ec.length == 2 && (byte)ec.sequence[1] < 128 && ec.sequence[1] != 0) {
+					entries[c1 * 128 + (byte)ec.sequence[1]] = entry;
+				} else {
+					valid = false;
+				}
+			}
+		}
+	};
+	
+	static constexpr EscapeLookupTable s_escapeLookup;
+	
+	static_assert(s_escapeLookup.valid, "Escape sequences must contain one or two ASCII characters");
+	
+	byte Keywords::findEscapeCode(Tokenizer::iterator begin, Tokenizer::iterator end, size_t & out_matched_size) const
+	{
+		if (begin == end) {
+			return 0;
+		}
+		const byte c1 = *begin;
+		if (c1 >= 128) {
+			return 0;
+		}
+		// Missing or non-ASCII second character is looked up as NUL, which
+		// matches only the single character sequences.
+		byte c2 = std::next(begin) != end ? *std::next(begin) : 0;
+		if (c2 >= 128) {
+			c2 = 0;
+		}
+		const U16 entry = s_escapeLookup.entries[c1 * 128 + c2];
+		if (entry != 0) {
+			out_matched_size = entry >> 8;
 		}
-		table.push_back(EscapeCode {"*", 0x7F});		// copyright sign
-		table.push_back(EscapeCode {"`", 0x60});		// pound sign
-		table.push_back(EscapeCode {"\\", '\\'});		// backslash
-		table.push_back(EscapeCode {"@", '@'});			// @
-		return table;
+		return static_cast<byte>(entry);
 	}
 	
 
@@ -0,0 +1,142 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/bas/SymbolTable.h>
+#include <assert.h>
+
+namespace bastapir
+{
+namespace bas
+{
+	/// Initial number of slots in hash table. Must be power of two.
+	static const size_t INITIAL_CAPACITY = 64;
+
+	// MARK: - Public interface
+
+	SymbolTable::SymbolTable()
+	{
+		rehash(INITIAL_CAPACITY);
+	}
+
+	void SymbolTable::clear()
+	{
+		truncate(0);
+	}
+
+	void SymbolTable::truncate(size_t count)
+	{
+		if (count >= _symbols.size()) {
+			return;
+		}
+		_symbols.resize(count);
+		rehash(_slots.size());
+	}
+
+	size_t SymbolTable::size() const
+	{
+		return _symbols.size();
+	}
+
+	SymbolTable::SymbolID SymbolTable::find(std::string_view name) const
+	{
+		return _slots[findSlot(name, hashName(name))].id;
+	}
+
+	SymbolTable::SymbolID SymbolTable::intern(std::string_view name, bool & added)
+	{
+		const U32 hash = hashName(name);
+		size_t index = findSlot(name, hash);
+		if (_slots[index].id != NotFound) {
+			added = false;
+			return _slots[index].id;
+		}
+		// Keep the load factor below 1/2, so probe sequences stay short.
+		if ((_symbols.size() + 1) * 2 > _slots.size()) {
+			rehash(_slots.size() * 2);
+			index = findSlot(name, hash);
+		}
+		const SymbolID id = static_cast<SymbolID>(_symbols.size());
+		_symbols.emplace_back();
+		_symbols.back().name = std::string(name);
+		_slots[index] = Slot { hash, id };
+		added = true;
+		return id;
+	}
+
+	SymbolTable::SymbolID SymbolTable::intern(std::string_view name)
+	{
+		bool added;
+		return intern(name, added);
+	}
+
+	SymbolTable::Symbol & SymbolTable::symbol(SymbolID id)
+	{
+		assert(id < _symbols.size());
+		return _symbols[id];
+	}
+
+	const SymbolTable::Symbol & SymbolTable::symbol(SymbolID id) const
+	{
+		assert(id < _symbols.size());
+		return _symbols[id];
+	}
+
+	// MARK: - Private methods
+
+	U32 SymbolTable::hashName(std::string_view name)
+	{
+		// FNV-1a hash
+		U32 hash = 2166136261u;
+		for (char c: name) {
+			hash = (hash ^ (byte)c) * 16777619u;
+		}
+		return hash;
+	}
+
+	size_t SymbolTable::findSlot(std::string_view name, U32 hash) const
+	{
+		const size_t mask = _slots.size() - 1;
+		size_t index = hash & mask;
+		while (true) {
+			const Slot & slot = _slots[index];
+			if (slot.id == NotFound) {
+				return index;
+			}
+			if (slot.hash == hash && _symbols[slot.id].name == name) {
+				return index;
+			}
+			// Linear probing
+			index = (index + 1) & mask;
+		}
+	}
+
+	void SymbolTable::rehash(size_t capacity)
+	{
+		assert((capacity & (capacity - 1)) == 0);
+		_slots.assign(capacity, Slot { 0, NotFound });
+		const size_t mask = capacity - 1;
+		for (SymbolID id = 0; id < _symbols.size(); id++) {
+			const U32 hash = hashName(_symbols[id].name);
+			size_t index = hash & mask;
+			while (_slots[index].id != NotFound) {
+				index = (index + 1) & mask;
+			}
+			_slots[index] = Slot { hash, id };
+		}
+	}
+
+} // bastapir::bas
+} // bastapir
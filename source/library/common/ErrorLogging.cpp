@@ -24,8 +24,7 @@ namespace bastapir
 		_out(std_out),
 		_err(err_out),
 		_min_severity(SevInfo),
-		_close_streams(close_streams),
-		_info({0,0})
+		_close_streams(close_streams)
 	{
 	}
 	
@@ -66,19 +65,19 @@ namespace bastapir
 	// MARK: - ErrorLogging interface
 	
 	void FileErrorLogger::error(const std::string & message) {
-		_info.errorsCount++;
+		_counters.errorsCount.fetch_add(1, std::memory_order_relaxed);
 		dump(_err, SevError, ErrorInfo(), message);
 	}
 	void FileErrorLogger::error(const ErrorInfo & info, const std::string & message) {
-		_info.errorsCount++;
+		_counters.errorsCount.fetch_add(1, std::memory_order_relaxed);
 		dump(_err, SevError, info, message);
 	}
 	void FileErrorLogger::warning(const std::string & message) {
-		_info.warningsCount++;
+		_counters.warningsCount.fetch_add(1, std::memory_order_relaxed);
 		dump(_err, SevWarning, ErrorInfo(), message);
 	}
 	void FileErrorLogger::warning(const ErrorInfo & info, const std::string & message) {
-		_info.warningsCount++;
+		_counters.warningsCount.fetch_add(1, std::memory_order_relaxed);
 		dump(_err, SevWarning, info, message);
 	}
 	void FileErrorLogger::info(const std::string & message) {
@@ -94,10 +93,10 @@ namespace bastapir
 		dump(_out, SevDebug, info, message);
 	}
 	ErrorLogging::Info FileErrorLogger::getInfo() const {
-		return _info;
+		return _counters.info();
 	}
 	void FileErrorLogger::resetInfo() {
-		_info = {0, 0};
+		_counters.reset();
 	}
 	
 	
@@ -109,7 +108,10 @@ namespace bastapir
 			return;
 		}
 		
-		std::string out = _prefix;
+		// The message is composed in a buffer reused by the calling thread and then written
+		// at once, so messages from multiple threads never interleave.
+		thread_local std::string out;
+		out.assign(_prefix);
 		
 		if (ei.hasInfo()) {
 			out += ei.sourceFile;
@@ -136,15 +138,14 @@ namespace bastapir
 		}
 		out += message;
 		out += "\n";
-		fputs(out.c_str(), stream);
+		fwrite(out.data(), 1, out.size(), stream);
 	}
 
 	
 	
 	// MARK: - Redirecting logger -
 	
-	RedirectingErrorLogger::RedirectingErrorLogger() :
-		_info({0,0})
+	RedirectingErrorLogger::RedirectingErrorLogger()
 	{
 	}
 	
@@ -171,7 +172,7 @@ namespace bastapir
 		error(ErrorInfo(), message);
 	}
 	void RedirectingErrorLogger::error(const ErrorInfo & info, const std::string & message) {
-		_info.errorsCount++;
+		_counters.errorsCount.fetch_add(1, std::memory_order_relaxed);
 		for (auto log: _loggers) {
 			log->error(info, message);
 		}
@@ -180,7 +181,7 @@ namespace bastapir
 		warning(ErrorInfo(), message);
 	}
 	void RedirectingErrorLogger::warning(const ErrorInfo & info, const std::string & message) {
-		_info.warningsCount++;
+		_counters.warningsCount.fetch_add(1, std::memory_order_relaxed);
 		for (auto log: _loggers) {
 			log->warning(info, message);
 		}
@@ -202,9 +203,97 @@ namespace bastapir
 		}
 	}
 	ErrorLogging::Info RedirectingErrorLogger::getInfo() const {
-		return _info;
+		return _counters.info();
 	}
 	void RedirectingErrorLogger::resetInfo() {
+		_counters.reset();
+	}
+	
+	
+	// MARK: - Buffered logger -
+	
+	BufferedErrorLogger::BufferedErrorLogger() :
+		_info({0,0})
+	{
+	}
+	
+	BufferedErrorLogger::~BufferedErrorLogger()
+	{
+	}
+	
+	bool BufferedErrorLogger::isEmpty() const
+	{
+		return _messages.empty();
+	}
+	
+	const std::vector<BufferedErrorLogger::Message> & BufferedErrorLogger::messages() const
+	{
+		return _messages;
+	}
+	
+	void BufferedErrorLogger::clear()
+	{
+		_messages.clear();
+	}
+	
+	void BufferedErrorLogger::append(const Message & message)
+	{
+		if (message.severity == SevError) {
+			_info.errorsCount++;
+		} else if (message.severity == SevWarning) {
+			_info.warningsCount++;
+		}
+		_messages.push_back(message);
+	}
+	
+	void BufferedErrorLogger::flush(ErrorLogging * target)
+	{
+		for (auto && m: _messages) {
+			switch (m.severity) {
+				case SevError: target->error(m.info, m.message);
+					break;
+				case SevWarning: target->warning(m.info, m.message);
+					break;
+				case SevInfo: target->info(m.info, m.message);
+					break;
+				case SevDebug: target->debug(m.info, m.message);
+					break;
+			}
+		}
+		_messages.clear();
+	}
+	
+	// ErrorLogging interface
+	void BufferedErrorLogger::error(const std::string & message) {
+		error(ErrorInfo(), message);
+	}
+	void BufferedErrorLogger::error(const ErrorInfo & info, const std::string & message) {
+		_info.errorsCount++;
+		_messages.push_back({ SevError, info, message });
+	}
+	void BufferedErrorLogger::warning(const std::string & message) {
+		warning(ErrorInfo(), message);
+	}
+	void BufferedErrorLogger::warning(const ErrorInfo & info, const std::string & message) {
+		_info.warningsCount++;
+		_messages.push_back({ SevWarning, info, message });
+	}
+	void BufferedErrorLogger::info(const std::string & message) {
+		info(ErrorInfo(), message);
+	}
+	void BufferedErrorLogger::info(const ErrorInfo & info, const std::string & message) {
+		_messages.push_back({ SevInfo, info, message });
+	}
+	void BufferedErrorLogger::debug(const std::string & message) {
+		debug(ErrorInfo(), message);
+	}
+	void BufferedErrorLogger::debug(const ErrorInfo & info, const std::string & message) {
+		_messages.push_back({ SevDebug, info, message });
+	}
+	ErrorLogging::Info BufferedErrorLogger::getInfo() const {
+		return _info;
+	}
+	void BufferedErrorLogger::resetInfo() {
 		_info = {0, 0};
 	}
 
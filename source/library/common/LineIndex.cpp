@@ -0,0 +1,78 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/common/LineIndex.h>
+#include "TextScan.h"
+
+namespace bastapir
+{
+	LineIndex::LineIndex() :
+		_bufferSize(0)
+	{
+		_begins.push_back(0);
+		_ends.push_back(0);
+	}
+
+	LineIndex::LineIndex(const std::string & str)
+	{
+		build(str.data(), str.data() + str.size());
+	}
+
+	LineIndex::LineIndex(const char * begin, const char * end)
+	{
+		build(begin, end);
+	}
+
+	bool LineIndex::hasInvalidLineEnd(size_t line) const
+	{
+		if (_invalidLineEnds.empty()) {
+			return false;
+		}
+		return std::binary_search(_invalidLineEnds.begin(), _invalidLineEnds.end(), line);
+	}
+
+	void LineIndex::build(const char * begin, const char * end)
+	{
+		_bufferSize = end - begin;
+		// Offsets are stored as 32 bit values.
+		assert(_bufferSize <= 0xFFFFFFFF);
+
+		_begins.clear();
+		_ends.clear();
+		_invalidLineEnds.clear();
+
+		const char * p = begin;
+		while (true) {
+			const char * line_end = scan::FindLineEnd(p, end);
+			_begins.push_back(static_cast<U32>(p - begin));
+			_ends.push_back(static_cast<U32>(line_end - begin));
+			if (line_end == end) {
+				break;
+			}
+			p = line_end + 1;
+			if (*line_end == '\r') {
+				if (p != end && *p == '\n') {
+					// CR-LF
+					++p;
+				} else {
+					// Standalone CR
+					_invalidLineEnds.push_back(_begins.size() - 1);
+				}
+			}
+		}
+	}
+
+} // bastapir
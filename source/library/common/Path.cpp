@@ -18,11 +18,11 @@
 
 namespace bastapir
 {
-#if defined(BASTAPIR_UNIX)
+#if BASTAPIR_UNIX
 	// macOS, Linux, + other right systems
 	static const char s_other_separator = '\\';
 	static const char s_right_separator = '/';
-#elif defined(BASTAPIR_WIN)
+#elif BASTAPIR_WIN
 	// Windows,  MS-DOS, etc... :D
 	static const char s_other_separator = '/';
 	static const char s_right_separator = '\\';
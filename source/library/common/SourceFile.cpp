@@ -16,10 +16,75 @@
 
 #include <bastapir/common/SourceFile.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 
+#if BASTAPIR_UNIX
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
 namespace bastapir
 {
+	/// Files smaller than this limit are read into buffer, because mapping of such
+	/// small file costs more than copying its content.
+	static const size_t MMAP_THRESHOLD = 16 * 1024;
+	
+	/// Size of one chunk read from file with unknown length.
+	static const size_t READ_CHUNK_SIZE = 64 * 1024;
+	
+	// MARK: - File content -
+	
+	/// The `SourceFile::Content` class owns file content, which is either mapped
+	/// into memory, or read into the buffer.
+	class SourceFile::Content
+	{
+	public:
+		/// Constructs content mapped into memory at |address|.
+		Content(void * address, size_t size) :
+			_mappedAddress(address),
+			_mappedSize(size)
+		{
+		}
+		
+		/// Constructs content from bytes loaded into |buffer|.
+		Content(ByteArray && buffer) :
+			_mappedAddress(nullptr),
+			_mappedSize(0),
+			_buffer(std::move(buffer))
+		{
+		}
+		
+		~Content()
+		{
+#if BASTAPIR_UNIX
+			if (_mappedAddress) {
+				munmap(_mappedAddress, _mappedSize);
+			}
+#endif
+		}
+		
+		Content(const Content &) = delete;
+		Content & operator=(const Content &) = delete;
+		
+		/// Returns range of content's bytes.
+		ByteRange bytes() const
+		{
+			if (_mappedAddress) {
+				return ByteRange(_mappedAddress, _mappedSize);
+			}
+			return _buffer.byteRange();
+		}
+		
+	private:
+		void * _mappedAddress;
+		size_t _mappedSize;
+		ByteArray _buffer;
+	};
+	
+	
 	// MARK: - Generic source file -
 	
 	SourceFile::SourceFile(const SourceFileInfo & info) :
@@ -32,12 +97,12 @@ namespace bastapir
 	{
 	}
 	
-	SourceFile SourceFile::open(const Path & path, SourceFileInfo::Mode mode)
+	SourceFile SourceFile::open(const Path & path, SourceFileInfo::Mode mode, Loading loading)
 	{
 		if (mode == SourceFileInfo::Text) {
-			return SourceTextFile(path);
+			return SourceTextFile(path, loading);
 		}
-		return SourceBinaryFile(path);
+		return SourceBinaryFile(path, loading);
 	}
 	
 	// MARK: Properties
@@ -57,104 +122,153 @@ namespace bastapir
 		return _is_valid && _error.empty();
 	}
 	
+	std::shared_ptr<const void> SourceFile::storage() const
+	{
+		return _content;
+	}
+	
 	
 	// MARK: Private
 	
-	void SourceFile::open(std::string * out_str, ByteArray * out_bin)
+	ByteRange SourceFile::content() const
+	{
+		return _content ? _content->bytes() : ByteRange();
+	}
+	
+	void SourceFile::open(Loading loading)
 	{
-		const bool is_text = _info.mode == SourceFileInfo::Text;
-		
-		if (is_text) assert(out_str != nullptr && out_bin == nullptr);
-		if (!is_text) assert(out_str == nullptr && out_bin != nullptr);
-		
 		_is_valid = false;
 		_error.clear();
-
+		_content.reset();
+		
+#if BASTAPIR_UNIX
+		if (loading == MapLargeFiles && mapContent()) {
+			_is_valid = true;
+			return;
+		}
+#else
+		// Mapping is not supported, so files are always read.
+		(void)loading;
+#endif
+		readContent();
+	}
+	
+#if BASTAPIR_UNIX
+	bool SourceFile::mapContent()
+	{
+		// Errors are not reported here, reading will report them later.
+		struct stat st;
+		if (stat(_info.path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+			return false;
+		}
+		const size_t length = (size_t)st.st_size;
+		if (length < MMAP_THRESHOLD) {
+			return false;
+		}
+		int fd = ::open(_info.path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		void * address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (address == MAP_FAILED) {
+			// Continue with reading, if mapping is not supported by the filesystem.
+			return false;
+		}
+		_content = std::make_shared<const Content>(address, length);
+		return true;
+	}
+#endif
+	
+	void SourceFile::readContent()
+	{
 		// Open file
-		FILE * f = fopen(_info.path.c_str(), is_text ? "r" : "rb");
+		FILE * f = fopen(_info.path.c_str(), "rb");
 		if (!f) {
 			_error = "Unable to open file (" + std::string(strerror(errno)) + ")";
 			return;
 		}
-		// Determine length
-		if (fseek(f, 0, SEEK_END) < 0) {
-			_error = "Unable to determine length of the file (" + std::string(strerror(errno)) + ")";
-			return;
-		}
-		long length = ftell(f);
-		if (fseek(f, 0, SEEK_SET) < 0) {
-			_error = "Cannot rewind file (" + std::string(strerror(errno)) + ")";
-			return;
+		// Determine length. The length is unknown for pipes, so read until end of file.
+		// One extra byte allows to detect end of regular file without reallocation.
+		size_t length_hint = 0;
+		if (fseek(f, 0, SEEK_END) == 0) {
+			long length = ftell(f);
+			if (length >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+				length_hint = (size_t)length + 1;
+			}
 		}
+		clearerr(f);
 		
-		// Allocate buffers
-		if (_info.mode == SourceFileInfo::Text) {
-			out_str->clear();
-			out_str->reserve(length);
-		} else {
-			out_bin->clear();
-			out_bin->reserve(length);
-		}
+		// Read data. The first chunk is limited, because some files, like directories,
+		// report bogus length and fail on the first read.
 		ByteArray buffer;
-		buffer.resize(std::min((long)65536, length));
-		
-		// Read data
-		
-		bool result = true;
+		buffer.resize(length_hint > 0 ? std::min(length_hint, READ_CHUNK_SIZE) : READ_CHUNK_SIZE);
+		size_t size = 0;
 		while (true) {
-			size_t res = fread(buffer.data(), 1, buffer.size(), f);
-			if (!res) {
+			if (size == buffer.size()) {
+				buffer.resize(std::max(size * 2, length_hint));
+			}
+			size_t res = fread(buffer.data() + size, 1, buffer.size() - size, f);
+			size += res;
+			if (res == 0) {
 				if (ferror(f)) {
 					_error = "Cannot read from file (" + std::string(strerror(errno)) + ")";
-					result = false;
+					fclose(f);
+					return;
 				}
 				break;
 			}
-			if (is_text) {
-				out_str->append((const char*)buffer.data(), res);
-			} else {
-				out_bin->append(buffer.data(), res);
-			}
 		}
 		fclose(f);
-		_is_valid = result;
+		buffer.resize(size);
+		_content = std::make_shared<const Content>(std::move(buffer));
+		_is_valid = true;
 	}
 	
 	
 	// MARK: - Text file -
 	
-	SourceTextFile::SourceTextFile(const Path & path) :
+	SourceTextFile::SourceTextFile(const Path & path, Loading loading) :
 		SourceFile(SourceFileInfo { path.path, SourceFileInfo::Text })
 	{
-		open(&_content, nullptr);
+		open(loading);
 	}
 	
 	SourceTextFile::~SourceTextFile()
 	{
 	}
 	
-	const std::string & SourceTextFile::string() const
+	std::string_view SourceTextFile::string() const
 	{
-		return _content;
+		auto bytes = content();
+		return std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+	
+	std::shared_ptr<const LineIndex> SourceTextFile::lineIndex() const
+	{
+		if (!_lineIndex) {
+			auto str = string();
+			_lineIndex = std::make_shared<LineIndex>(str.data(), str.data() + str.size());
+		}
+		return _lineIndex;
 	}
 	
 	
 	// MARK: - Binary file -
 	
-	SourceBinaryFile::SourceBinaryFile(const Path & path) :
+	SourceBinaryFile::SourceBinaryFile(const Path & path, Loading loading) :
 		SourceFile(SourceFileInfo { path.path, SourceFileInfo::Binary })
 	{
-		open(nullptr, &_content);
+		open(loading);
 	}
 	
 	SourceBinaryFile::~SourceBinaryFile()
 	{
 	}
 	
-	const ByteArray & SourceBinaryFile::bytes() const
+	ByteRange SourceBinaryFile::bytes() const
 	{
-		return _content;
+		return content();
 	}
 	
 } // bastapir
-
@@ -0,0 +1,301 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "TextScan.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#if defined(__AVX2__)
+		#include <immintrin.h>
+		#define BASTAPIR_SCAN_AVX2	1
+	#else
+		#define BASTAPIR_SCAN_AVX2	0
+	#endif
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+	#define BASTAPIR_SCAN_SSE2	1
+#else
+	#define BASTAPIR_SCAN_SSE2	0
+	#define BASTAPIR_SCAN_AVX2	0
+#endif
+
+namespace bastapir
+{
+namespace scan
+{
+	// MARK: - Helpers
+
+#if BASTAPIR_SCAN_SSE2
+	/// Returns index of the lowest bit set in non-zero |mask|.
+	static inline unsigned LowestBit(unsigned mask)
+	{
+	#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return index;
+	#else
+		return __builtin_ctz(mask);
+	#endif
+	}
+
+	/// Returns mask with 0xFF in lanes where |low| <= c <= |high|. Both boundaries must be
+	/// in ASCII range, so characters above 0x7F, which are negative, never match.
+	static inline __m128i InRange(__m128i c, char low, char high)
+	{
+		return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(low - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(high + 1)));
+	}
+
+	/// Returns mask with 0xFF in lanes equal to |v|.
+	static inline __m128i Equal(__m128i c, char v)
+	{
+		return _mm_cmpeq_epi8(c, _mm_set1_epi8(v));
+	}
+#endif
+
+#if BASTAPIR_SCAN_AVX2
+	static inline __m256i InRange(__m256i c, char low, char high)
+	{
+		return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(low - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(high + 1), c));
+	}
+
+	static inline __m256i Equal(__m256i c, char v)
+	{
+		return _mm256_cmpeq_epi8(c, _mm256_set1_epi8(v));
+	}
+#endif
+
+	// MARK: - Character classes
+
+	//
+	// Each character class provides scalar test and vector tests for all supported
+	// instruction sets. The vector test returns 0xFF in lanes matching the class.
+	//
+
+	struct LineEndClass
+	{
+		static bool test(char c)
+		{
+			return c == '\n' || c == '\r';
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			return _mm_or_si128(Equal(c, '\n'), Equal(c, '\r'));
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			return _mm256_or_si256(Equal(c, '\n'), Equal(c, '\r'));
+		}
+	#endif
+	};
+
+	struct WhitespaceClass
+	{
+		static bool test(char c)
+		{
+			return c == ' ' || (c >= '\t' && c <= '\r');
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			return _mm_or_si128(Equal(c, ' '), InRange(c, '\t', '\r'));
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			return _mm256_or_si256(Equal(c, ' '), InRange(c, '\t', '\r'));
+		}
+	#endif
+	};
+
+	struct DigitClass
+	{
+		static bool test(char c)
+		{
+			return c >= '0' && c <= '9';
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			return InRange(c, '0', '9');
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			return InRange(c, '0', '9');
+		}
+	#endif
+	};
+
+	struct AlphanumericClass
+	{
+		static bool test(char c)
+		{
+			const char lower = c | 0x20;
+			return (c >= '0' && c <= '9') || (lower >= 'a' && lower <= 'z');
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+			return _mm_or_si128(InRange(c, '0', '9'), InRange(lower, 'a', 'z'));
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			const __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+			return _mm256_or_si256(InRange(c, '0', '9'), InRange(lower, 'a', 'z'));
+		}
+	#endif
+	};
+
+	struct HexDigitClass
+	{
+		static bool test(char c)
+		{
+			const char lower = c | 0x20;
+			return (c >= '0' && c <= '9') || (lower >= 'a' && lower <= 'f');
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			const __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+			return _mm_or_si128(InRange(c, '0', '9'), InRange(lower, 'a', 'f'));
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			const __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+			return _mm256_or_si256(InRange(c, '0', '9'), InRange(lower, 'a', 'f'));
+		}
+	#endif
+	};
+
+	struct StringSpecialClass
+	{
+		static bool test(char c)
+		{
+			return c == '"' || c == '\\' || c == 0;
+		}
+	#if BASTAPIR_SCAN_SSE2
+		static __m128i test(__m128i c)
+		{
+			return _mm_or_si128(_mm_or_si128(Equal(c, '"'), Equal(c, '\\')), Equal(c, 0));
+		}
+	#endif
+	#if BASTAPIR_SCAN_AVX2
+		static __m256i test(__m256i c)
+		{
+			return _mm256_or_si256(_mm256_or_si256(Equal(c, '"'), Equal(c, '\\')), Equal(c, 0));
+		}
+	#endif
+	};
+
+	// MARK: - Generic scan
+
+	/// Returns pointer to the first character in range, for which the class test
+	/// is equal to |Match| parameter.
+	template <typename Class, bool Match>
+	static inline const char * Scan(const char * begin, const char * end)
+	{
+		const char * p = begin;
+	#if BASTAPIR_SCAN_AVX2
+		while (end - p >= 32) {
+			__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(Class::test(chunk)));
+			if (!Match) {
+				mask = ~mask;
+			}
+			if (mask) {
+				return p + LowestBit(mask);
+			}
+			p += 32;
+		}
+	#endif
+	#if BASTAPIR_SCAN_SSE2
+		while (end - p >= 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(Class::test(chunk)));
+			if (!Match) {
+				mask ^= 0xFFFF;
+			}
+			if (mask) {
+				return p + LowestBit(mask);
+			}
+			p += 16;
+		}
+	#endif
+		while (p != end) {
+			if (Class::test(*p) == Match) {
+				break;
+			}
+			++p;
+		}
+		return p;
+	}
+
+	// MARK: - Kernels
+
+	const char * FindLineEnd(const char * begin, const char * end)
+	{
+		return Scan<LineEndClass, true>(begin, end);
+	}
+
+	const char * SkipWhitespace(const char * begin, const char * end)
+	{
+		return Scan<WhitespaceClass, false>(begin, end);
+	}
+
+	const char * SkipAlphanumeric(const char * begin, const char * end)
+	{
+		return Scan<AlphanumericClass, false>(begin, end);
+	}
+
+	const char * SkipDigits(const char * begin, const char * end)
+	{
+		return Scan<DigitClass, false>(begin, end);
+	}
+
+	const char * SkipHexDigits(const char * begin, const char * end)
+	{
+		return Scan<HexDigitClass, false>(begin, end);
+	}
+
+	const char * FindStringSpecial(const char * begin, const char * end)
+	{
+		return Scan<StringSpecialClass, true>(begin, end);
+	}
+
+	const char * InstructionSet()
+	{
+	#if BASTAPIR_SCAN_AVX2
+		return "AVX2";
+	#elif BASTAPIR_SCAN_SSE2
+		return "SSE2";
+	#else
+		return "scalar";
+	#endif
+	}
+
+} // bastapir::scan
+} // bastapir
@@ -0,0 +1,57 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#pragma once
+
+#include <bastapir/common/Types.h>
+
+namespace bastapir
+{
+namespace scan
+{
+	//
+	// Low level text scanning kernels. Each function looks for the first character
+	// in range <begin, end) which matches, or doesn't match some character class,
+	// and returns pointer to that character, or |end| if there's no such character.
+	//
+	// The functions process 32 bytes at once when AVX2 is enabled at compile time,
+	// 16 bytes with SSE2 and fall back to scalar loop otherwise. The character classes
+	// are equal to classes from <ctype.h> in the "C" locale.
+	//
+
+	/// Returns pointer to the first '\n' or '\r' character.
+	const char * FindLineEnd(const char * begin, const char * end);
+
+	/// Returns pointer to the first character which is not whitespace (see `isspace()`)
+	const char * SkipWhitespace(const char * begin, const char * end);
+
+	/// Returns pointer to the first character which is not alphanumeric (see `isalnum()`)
+	const char * SkipAlphanumeric(const char * begin, const char * end);
+
+	/// Returns pointer to the first character which is not decimal digit (see `isdigit()`)
+	const char * SkipDigits(const char * begin, const char * end);
+
+	/// Returns pointer to the first character which is not hexadecimal digit (see `isxdigit()`)
+	const char * SkipHexDigits(const char * begin, const char * end);
+
+	/// Returns pointer to the first double quote, backslash or NUL character.
+	const char * FindStringSpecial(const char * begin, const char * end);
+
+	/// Returns name of instruction set used by the kernels.
+	const char * InstructionSet();
+
+} // bastapir::scan
+} // bastapir
@@ -0,0 +1,125 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/common/ThreadPool.h>
+
+namespace bastapir
+{
+	ThreadPool::ThreadPool(size_t threads) :
+		_job(nullptr),
+		_jobsCount(0),
+		_nextJob(0),
+		_activeWorkers(0),
+		_batchGeneration(0),
+		_stop(false)
+	{
+		if (threads == 0) {
+			threads = hardwareThreads();
+		}
+		// The calling thread is also used for jobs.
+		for (size_t i = 1; i < threads; i++) {
+			_workers.emplace_back(&ThreadPool::workerLoop, this);
+		}
+	}
+	
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_batchStarted.notify_all();
+		for (auto && worker: _workers) {
+			worker.join();
+		}
+	}
+	
+	size_t ThreadPool::threadsCount() const
+	{
+		return _workers.size() + 1;
+	}
+	
+	size_t ThreadPool::hardwareThreads()
+	{
+		const size_t count = std::thread::hardware_concurrency();
+		return count > 0 ? count : 1;
+	}
+	
+	void ThreadPool::run(size_t count, const std::function<void(size_t)> & job)
+	{
+		if (count == 0) {
+			return;
+		}
+		if (_workers.empty() || count == 1) {
+			// Nothing to distribute.
+			for (size_t i = 0; i < count; i++) {
+				job(i);
+			}
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_job = &job;
+			_jobsCount = count;
+			_nextJob = 0;
+			_activeWorkers = _workers.size();
+			_batchGeneration++;
+		}
+		_batchStarted.notify_all();
+		
+		executeJobs();
+		
+		// Wait for workers, they may still execute their last jobs.
+		std::unique_lock<std::mutex> lock(_mutex);
+		_batchFinished.wait(lock, [this] { return _activeWorkers == 0; });
+		_job = nullptr;
+	}
+	
+	// MARK: - Private
+	
+	void ThreadPool::workerLoop()
+	{
+		U64 generation = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_batchStarted.wait(lock, [&] { return _stop || _batchGeneration != generation; });
+				if (_stop) {
+					return;
+				}
+				generation = _batchGeneration;
+			}
+			executeJobs();
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_activeWorkers--;
+			}
+			_batchFinished.notify_one();
+		}
+	}
+	
+	void ThreadPool::executeJobs()
+	{
+		while (true) {
+			const size_t index = _nextJob.fetch_add(1);
+			if (index >= _jobsCount) {
+				break;
+			}
+			(*_job)(index);
+		}
+	}
+	
+} // bastapir
@@ -15,6 +15,7 @@
 //
 
 #include <bastapir/common/Tokenizer.h>
+#include "TextScan.h"
 #include <assert.h>
 #include <ctype.h>
 
@@ -41,9 +42,23 @@ namespace bastapir
 	void Tokenizer::resetTo(const Range range)
 	{
 		_str = range;
+		_lineIndex.reset();
 		reset();
 	}
 	
+	void Tokenizer::resetTo(const Range range, std::shared_ptr<const LineIndex> line_index)
+	{
+		assert(!line_index || line_index->bufferSize() == (size_t)(range.end - range.begin));
+		_str = range;
+		_lineIndex = line_index;
+		reset();
+	}
+	
+	const std::shared_ptr<const LineIndex> & Tokenizer::lineIndex() const
+	{
+		return _lineIndex;
+	}
+	
 	void Tokenizer::resetTo(const iterator begin, const iterator end)
 	{
 		resetTo(Range { begin, end});
@@ -192,6 +207,9 @@ namespace bastapir
 	
 	bool Tokenizer::nextLine()
 	{
+		if (_lineIndex) {
+			return nextIndexedLine();
+		}
 		if (!_stop_at_lf) {
 			updateLineEnd();
 		} else {
@@ -210,7 +228,10 @@ namespace bastapir
 					if (_log) {
 						_log->error("Tokenizer: Invalid CR-LF sequence detected.");
 					}
-					_state.pos--;
+					if (c != 0) {
+						// Don't step back when CR is the last character.
+						_state.pos--;
+					}
 				}
 			}
 			_state.lineNumber++;
@@ -239,7 +260,32 @@ namespace bastapir
 	
 	bool Tokenizer::skipWhitespace()
 	{
-		return skipWhile(isspace);
+		scanWith(scan::SkipWhitespace);
+		return charAt() != 0;
+	}
+	
+	bool Tokenizer::skipAlphanumeric()
+	{
+		scanWith(scan::SkipAlphanumeric);
+		return charAt() != 0;
+	}
+	
+	bool Tokenizer::skipDigits()
+	{
+		scanWith(scan::SkipDigits);
+		return charAt() != 0;
+	}
+	
+	bool Tokenizer::skipHexDigits()
+	{
+		scanWith(scan::SkipHexDigits);
+		return charAt() != 0;
+	}
+	
+	bool Tokenizer::skipStringCharacters()
+	{
+		scanWith(scan::FindStringSpecial);
+		return !isEnd();
 	}
 	
 	bool Tokenizer::skipWhile(int (*function)(int))
@@ -349,16 +395,50 @@ namespace bastapir
 		return 0;
 	}
 	
+	void Tokenizer::scanWith(ScanKernel kernel)
+	{
+		const iterator end = limit().end;
+		if (_state.pos == end) {
+			return;
+		}
+		_state.pos = kernel(_state.pos, end);
+	}
+	
+	bool Tokenizer::nextIndexedLine()
+	{
+		const size_t next_line = _state.lineNumber + 1;
+		if (next_line >= _lineIndex->lineCount()) {
+			// Last line without terminator, move to the end of string.
+			_state.pos = _str.begin + _lineIndex->lineEnd(_state.lineNumber);
+			_state.line.begin = _state.pos;
+			_state.line.end   = _state.pos;
+			_state.updateLineEnd = false;
+			return false;
+		}
+		if (_lineIndex->hasInvalidLineEnd(_state.lineNumber) && _log) {
+			_log->error("Tokenizer: Invalid CR-LF sequence detected.");
+		}
+		_state.lineNumber	 = next_line;
+		_state.pos			 = _str.begin + _lineIndex->lineBegin(next_line);
+		_state.line.begin	 = _state.pos;
+		_state.line.end		 = _str.begin + _lineIndex->lineEnd(next_line);
+		_state.updateLineEnd = false;
+		if (_stop_at_lf) {
+			resetCapture();
+		}
+		return !isRealEnd();
+	}
+	
 	void Tokenizer::updateLineEnd()
 	{
+		if (_state.updateLineEnd && _lineIndex) {
+			_state.line.end = _str.begin + _lineIndex->lineEnd(_state.lineNumber);
+			_state.updateLineEnd = false;
+		}
 		if (_state.updateLineEnd) {
 			_state.line.end = _state.line.begin;
-			while (_state.line.end != _str.end) {
-				auto c = *_state.line.end;
-				if (c == '\n' || c == '\r') {
-					break;
-				}
-				++_state.line.end;
+			if (_state.line.end != _str.end) {
+				_state.line.end = scan::FindLineEnd(_state.line.end, _str.end);
 			}
 			_state.updateLineEnd = false;
 		}
@@ -0,0 +1,130 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/tap/ArchiveSink.h>
+#include <errno.h>
+
+#if BASTAPIR_UNIX
+	#include <sys/uio.h>
+	#include <unistd.h>
+#else
+	#include <io.h>
+#endif
+
+namespace bastapir
+{
+namespace tap
+{
+#if BASTAPIR_UNIX
+	/// Maximum number of buffers written in one `writev()` call. The value is below
+	/// the `IOV_MAX` limit on all supported systems.
+	static const size_t MAX_BUFFERS = 64;
+#else
+	/// Maximum number of bytes written in one `_write()` call.
+	static const size_t MAX_WRITE_SIZE = 1024 * 1024;
+#endif
+
+	// MARK: - ByteArraySink
+
+	ByteArraySink::ByteArraySink(ByteArray & out) :
+		_out(out)
+	{
+	}
+
+	bool ByteArraySink::write(const ByteRange * buffers, size_t count)
+	{
+		for (size_t i = 0; i < count; i++) {
+			_out.append(buffers[i]);
+		}
+		return true;
+	}
+
+	// MARK: - FileDescriptorSink
+
+	FileDescriptorSink::FileDescriptorSink(int fd) :
+		_fd(fd),
+		_writtenBytes(0)
+	{
+	}
+
+	size_t FileDescriptorSink::writtenBytes() const
+	{
+		return _writtenBytes;
+	}
+
+#if BASTAPIR_UNIX
+	bool FileDescriptorSink::write(const ByteRange * buffers, size_t count)
+	{
+		while (count > 0) {
+			iovec vectors[MAX_BUFFERS];
+			size_t vectors_count = 0;
+			for (; vectors_count < count && vectors_count < MAX_BUFFERS; vectors_count++) {
+				vectors[vectors_count].iov_base = const_cast<byte*>(buffers[vectors_count].data());
+				vectors[vectors_count].iov_len  = buffers[vectors_count].size();
+			}
+			buffers += vectors_count;
+			count   -= vectors_count;
+
+			// The system may write less bytes than requested, so continue with the rest.
+			iovec * vector = vectors;
+			while (vectors_count > 0) {
+				ssize_t written = writev(_fd, vector, static_cast<int>(vectors_count));
+				if (written < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					return false;
+				}
+				_writtenBytes += written;
+				while (vectors_count > 0 && (size_t)written >= vector->iov_len) {
+					written -= vector->iov_len;
+					vector++;
+					vectors_count--;
+				}
+				if (vectors_count > 0) {
+					vector->iov_base = static_cast<byte*>(vector->iov_base) + written;
+					vector->iov_len -= written;
+				}
+			}
+		}
+		return true;
+	}
+#else
+	bool FileDescriptorSink::write(const ByteRange * buffers, size_t count)
+	{
+		// Scatter-gather write is not available, so write buffers one by one.
+		for (size_t i = 0; i < count; i++) {
+			const byte * data = buffers[i].data();
+			size_t size = buffers[i].size();
+			while (size > 0) {
+				int written = _write(_fd, data, static_cast<unsigned int>(std::min(size, MAX_WRITE_SIZE)));
+				if (written < 0) {
+					if (errno == EINTR) {
+						continue;
+					}
+					return false;
+				}
+				_writtenBytes += written;
+				data += written;
+				size -= written;
+			}
+		}
+		return true;
+	}
+#endif
+
+} // bastapir::tap
+} // bastapir
@@ -0,0 +1,220 @@
+//
+// Copyright 2018 Juraj Durech <durech.juraj@gmail.com>
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <bastapir/tap/Checksum.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#if defined(__AVX2__)
+		#include <immintrin.h>
+		#define BASTAPIR_CHECKSUM_AVX2	1
+	#else
+		#define BASTAPIR_CHECKSUM_AVX2	0
+	#endif
+	#define BASTAPIR_CHECKSUM_SSE2	1
+	#define BASTAPIR_CHECKSUM_NEON	0
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define BASTAPIR_CHECKSUM_SSE2	0
+	#define BASTAPIR_CHECKSUM_AVX2	0
+	#define BASTAPIR_CHECKSUM_NEON	1
+#else
+	#define BASTAPIR_CHECKSUM_SSE2	0
+	#define BASTAPIR_CHECKSUM_AVX2	0
+	#define BASTAPIR_CHECKSUM_NEON	0
+#endif
+
+namespace bastapir
+{
+namespace tap
+{
+	// MARK: - Helpers
+
+	/// Returns XOR of all bytes in 64-bit |word|.
+	static inline byte FoldWord(U64 word)
+	{
+		word ^= word >> 32;
+		word ^= word >> 16;
+		word ^= word >> 8;
+		return static_cast<byte>(word);
+	}
+
+#if BASTAPIR_CHECKSUM_SSE2
+	/// Returns XOR of all bytes in |v| vector.
+	static inline byte FoldVector(__m128i v)
+	{
+		U64 words[2];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(words), v);
+		return FoldWord(words[0] ^ words[1]);
+	}
+#endif
+
+#if BASTAPIR_CHECKSUM_NEON
+	static inline byte FoldVector(uint8x16_t v)
+	{
+		const uint64x2_t words = vreinterpretq_u64_u8(v);
+		return FoldWord(vgetq_lane_u64(words, 0) ^ vgetq_lane_u64(words, 1));
+	}
+#endif
+
+	// MARK: - Generic kernel
+
+	/// Calculates XOR of all bytes in range <source, source + size) and optionally copies
+	/// the bytes to |destination|, if |Copy| parameter is true.
+	template <bool Copy>
+	static inline byte Checksum(byte * destination, const byte * source, size_t size)
+	{
+		const byte * p = source;
+		const byte * end = source + size;
+		byte * d = destination;
+		byte result = 0;
+	#if BASTAPIR_CHECKSUM_AVX2
+		if (end - p >= 64) {
+			__m256i acc0 = _mm256_setzero_si256();
+			__m256i acc1 = _mm256_setzero_si256();
+			do {
+				const __m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+				const __m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+				if (Copy) {
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(d), v0);
+					_mm256_storeu_si256(reinterpret_cast<__m256i*>(d + 32), v1);
+					d += 64;
+				}
+				acc0 = _mm256_xor_si256(acc0, v0);
+				acc1 = _mm256_xor_si256(acc1, v1);
+				p += 64;
+			} while (end - p >= 64);
+			const __m256i acc = _mm256_xor_si256(acc0, acc1);
+			result ^= FoldVector(_mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+		}
+	#endif
+	#if BASTAPIR_CHECKSUM_SSE2
+		if (end - p >= 16) {
+			// Two accumulators break the dependency chain between iterations.
+			__m128i acc0 = _mm_setzero_si128();
+			__m128i acc1 = _mm_setzero_si128();
+			while (end - p >= 64) {
+				const __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				const __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+				const __m128i v2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+				const __m128i v3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+				if (Copy) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(d), v0);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16), v1);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 32), v2);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 48), v3);
+					d += 64;
+				}
+				acc0 = _mm_xor_si128(acc0, _mm_xor_si128(v0, v1));
+				acc1 = _mm_xor_si128(acc1, _mm_xor_si128(v2, v3));
+				p += 64;
+			}
+			while (end - p >= 16) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+				if (Copy) {
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(d), v);
+					d += 16;
+				}
+				acc0 = _mm_xor_si128(acc0, v);
+				p += 16;
+			}
+			result ^= FoldVector(_mm_xor_si128(acc0, acc1));
+		}
+	#endif
+	#if BASTAPIR_CHECKSUM_NEON
+		if (end - p >= 16) {
+			uint8x16_t acc0 = vdupq_n_u8(0);
+			uint8x16_t acc1 = vdupq_n_u8(0);
+			while (end - p >= 64) {
+				const uint8x16_t v0 = vld1q_u8(p);
+				const uint8x16_t v1 = vld1q_u8(p + 16);
+				const uint8x16_t v2 = vld1q_u8(p + 32);
+				const uint8x16_t v3 = vld1q_u8(p + 48);
+				if (Copy) {
+					vst1q_u8(d, v0);
+					vst1q_u8(d + 16, v1);
+					vst1q_u8(d + 32, v2);
+					vst1q_u8(d + 48, v3);
+					d += 64;
+				}
+				acc0 = veorq_u8(acc0, veorq_u8(v0, v1));
+				acc1 = veorq_u8(acc1, veorq_u8(v2, v3));
+				p += 64;
+			}
+			while (end - p >= 16) {
+				const uint8x16_t v = vld1q_u8(p);
+				if (Copy) {
+					vst1q_u8(d, v);
+					d += 16;
+				}
+				acc0 = veorq_u8(acc0, v);
+				p += 16;
+			}
+			result ^= FoldVector(veorq_u8(acc0, acc1));
+		}
+	#endif
+		// Scalar loop, 8 bytes at once. This is also the tail of vector loops.
+		if (end - p >= 8) {
+			U64 acc = 0;
+			do {
+				U64 v;
+				memcpy(&v, p, sizeof(v));
+				if (Copy) {
+					memcpy(d, &v, sizeof(v));
+					d += 8;
+				}
+				acc ^= v;
+				p += 8;
+			} while (end - p >= 8);
+			result ^= FoldWord(acc);
+		}
+		while (p != end) {
+			if (Copy) {
+				*d++ = *p;
+			}
+			result ^= *p++;
+		}
+		return result;
+	}
+
+	// MARK: - Public functions
+
+	byte XorChecksum(byte leading, const ByteRange & bytes)
+	{
+		return leading ^ Checksum<false>(nullptr, bytes.data(), bytes.size());
+	}
+
+	byte CopyWithChecksum(byte * destination, byte leading, const ByteRange & bytes)
+	{
+		return leading ^ Checksum<true>(destination, bytes.data(), bytes.size());
+	}
+
+	const char * ChecksumInstructionSet()
+	{
+	#if BASTAPIR_CHECKSUM_AVX2
+		return "AVX2";
+	#elif BASTAPIR_CHECKSUM_SSE2
+		return "SSE2";
+	#elif BASTAPIR_CHECKSUM_NEON
+		return "NEON";
+	#else
+		return "scalar";
+	#endif
+	}
+
+} // bastapir::tap
+} // bastapir
@@ -21,9 +21,24 @@ namespace bastapir
 namespace tap
 {
 	FileEntry::FileEntry(const std::string & name, Type type, const ByteRange & bytes) :
+		FileEntry(name, type, ByteArray(bytes))
+	{
+	}
+	
+	FileEntry::FileEntry(const std::string & name, Type type, ByteArray && bytes) :
+		_fileName(name),
+		_fileType(type),
+		_fileParams({0, 0}),
+		_storage(std::make_shared<const ByteArray>(std::move(bytes))),
+		_bytes(static_cast<const ByteArray*>(_storage.get())->byteRange())
+	{
+	}
+	
+	FileEntry::FileEntry(const std::string & name, Type type, const ByteRange & bytes, std::shared_ptr<const void> storage) :
 		_fileName(name),
 		_fileType(type),
 		_fileParams({0, 0}),
+		_storage(std::move(storage)),
 		_bytes(bytes)
 	{
 	}
@@ -37,7 +52,7 @@ namespace tap
 	}
 	
 	const ByteRange FileEntry::bytes() const {
-		return _bytes.byteRange();
+		return _bytes;
 	}
 	
 	
@@ -15,6 +15,9 @@
 //
 
 #include <bastapir/tap/TapArchiveBuilder.h>
+#include <bastapir/tap/Checksum.h>
+#include <string.h>
+#include <algorithm>
 
 namespace bastapir
 {
@@ -36,97 +39,204 @@ namespace tap
 		return _sourceFileInfo;
 	}
 	
+	void TapArchiveBuilder::removeAllFiles() {
+		_files.clear();
+	}
+	
 	void TapArchiveBuilder::addFile(const FileEntry & entry) {
 		_files.push_back(entry);
 	}
+	
+	void TapArchiveBuilder::addFile(FileEntry && entry) {
+		_files.push_back(std::move(entry));
+	}
 
 	
 	ByteArray TapArchiveBuilder::build() const
 	{
+		if (!validate()) {
+			return ByteArray();
+		}
 		ByteArray out;
-		std::vector<FileEntry::ValidationResult> issues;
+		out.reserve(archiveSize());
+		byte header[HEADER_SIZE];
 		for (auto && file: _files) {
-			if (!file.validate(issues)) {
-				bool critical = false;
-				for (auto ec: issues) {
-					reportError(file, ec);
-					if (ec > FileEntry::ERR) {
-						critical = true;
-					}
-				}
-				if (critical) {
-					// TODO: throw exception...
-					return ByteArray();
+			serializeHeader(file, header);
+			appendTapeStream(out, MakeRange(header), true, true);
+			appendTapeStream(out, file.bytes(), false, true);
+		}
+		assert(out.size() == archiveSize());
+		return out;
+	}
+	
+	/// Number of files passed to the archive sink at once.
+	static const size_t WRITE_BATCH_SIZE = 8;
+	
+	bool TapArchiveBuilder::write(ArchiveSink & sink) const
+	{
+		// Blocks for several files are passed to the sink at once, so the file descriptor sink
+		// needs only one system call for the whole batch. The header block is small, so it's
+		// constructed in place. The data block is split to prefix, payload and checksum.
+		struct FileBlocks
+		{
+			byte header[2 + 1 + HEADER_SIZE + 1];
+			byte prefix[3];
+			byte checksum;
+		};
+		FileBlocks blocks[WRITE_BATCH_SIZE];
+		ByteRange buffers[WRITE_BATCH_SIZE * 4];
+		size_t batch_count = 0;
+		
+		for (size_t index = 0; index < _files.size(); index++) {
+			const FileEntry & file = _files[index];
+			const ByteRange bytes = file.bytes();
+			const size_t raw_size = bytes.size() + 2;
+			if (raw_size > 65536) {
+				assert(false);	// too many bytes
+				return false;
+			}
+			FileBlocks & block = blocks[batch_count];
+			byte header[HEADER_SIZE];
+			serializeHeader(file, header);
+			block.header[0] = HEADER_SIZE + 2;
+			block.header[1] = 0;
+			block.header[2] = 0x00;
+			memcpy(block.header + 3, header, HEADER_SIZE);
+			block.header[3 + HEADER_SIZE] = checksum(0x00, MakeRange(header));
+			
+			block.prefix[0] =  raw_size       & 0xFF;
+			block.prefix[1] = (raw_size >> 8) & 0xFF;
+			block.prefix[2] = 0xFF;
+			block.checksum  = checksum(0xFF, bytes);
+			
+			ByteRange * file_buffers = buffers + batch_count * 4;
+			file_buffers[0] = MakeRange(block.header);
+			file_buffers[1] = MakeRange(block.prefix);
+			file_buffers[2] = bytes;
+			file_buffers[3] = ByteRange(&block.checksum, 1);
+			
+			if (++batch_count == WRITE_BATCH_SIZE || index + 1 == _files.size()) {
+				if (!sink.write(buffers, batch_count * 4)) {
+					return false;
 				}
+				batch_count = 0;
 			}
-			auto headerBytes = serializeHeader(file);
-			out.append(serializeTapeStream(headerBytes, true, true));
-			out.append(serializeTapeStream(file.bytes(), false, true));
 		}
-		return out;
+		return true;
+	}
+	
+	size_t TapArchiveBuilder::archiveSize() const
+	{
+		size_t size = 0;
+		for (auto && file: _files) {
+			size += tapeStreamSize(HEADER_SIZE) + tapeStreamSize(file.bytes().size());
+		}
+		return size;
 	}
 	
 	// MARK: - Low level methods
 	
 	ByteArray TapArchiveBuilder::serializeHeader(const FileEntry & file)
 	{
-		ByteArray header;
-		header.reserve(17);
-		
+		byte header[HEADER_SIZE];
+		serializeHeader(file, header);
+		return ByteArray(MakeRange(header));
+	}
+	
+	void TapArchiveBuilder::serializeHeader(const FileEntry & file, byte (&out)[HEADER_SIZE])
+	{
 		// Crop name to 10 chars, or extend with blanks if name is shorter.
-		ByteArray name(MakeRange(file.name()));
-		name.resize(10, ' ');
-		
-		U16 length = file.bytes().size() & 0xFFFF;
+		const std::string & name = file.name();
+		const size_t name_length = std::min(name.size(), (size_t)10);
+		memcpy(out + 1, name.data(), name_length);
+		memset(out + 1 + name_length, ' ', 10 - name_length);
 		
-		header.append((byte)file.type());						// 0.  type
-		header.append(name);									// 1.  name                  (10 bytes)
-		header.append(MakeRange(length));						// 11. length of data block  (2 bytes)
-		header.append(MakeRange(file.params().generic.param1));	// 13. param1                (2 bytes)
-		header.append(MakeRange(file.params().generic.param2)); // 15. param2                (2 bytes)
+		const U16 length = file.bytes().size() & 0xFFFF;
+		const U16 param1 = file.params().generic.param1;
+		const U16 param2 = file.params().generic.param2;
 		
-		assert(header.size() == 17);
-		
-		return header;
+		out[0]  = (byte)file.type();		// 0.  type
+											// 1.  name                  (10 bytes)
+		out[11] =  length       & 0xFF;		// 11. length of data block  (2 bytes)
+		out[12] = (length >> 8) & 0xFF;
+		out[13] =  param1       & 0xFF;		// 13. param1                (2 bytes)
+		out[14] = (param1 >> 8) & 0xFF;
+		out[15] =  param2       & 0xFF;		// 15. param2                (2 bytes)
+		out[16] = (param2 >> 8) & 0xFF;
 	}
 	
+	size_t TapArchiveBuilder::tapeStreamSize(size_t bytes_count, bool is_tap_block)
+	{
+		// Optional block size, leading byte, bytes and checksum.
+		return (is_tap_block ? 2 : 0) + 1 + bytes_count + 1;
+	}
 	
 	ByteArray TapArchiveBuilder::serializeTapeStream(const ByteRange & bytes, bool is_header, bool is_tap_block)
 	{
-		if (is_header && bytes.size() != 17) {
-			assert(false);	// header must be 17 bytes long
+		ByteArray out;
+		out.reserve(tapeStreamSize(bytes.size(), is_tap_block));
+		if (!appendTapeStream(out, bytes, is_header, is_tap_block)) {
 			return ByteArray();
 		}
+		return out;
+	}
+	
+	bool TapArchiveBuilder::appendTapeStream(ByteArray & out, const ByteRange & bytes, bool is_header, bool is_tap_block)
+	{
+		if (is_header && bytes.size() != HEADER_SIZE) {
+			assert(false);	// header must be 17 bytes long
+			return false;
+		}
 		const size_t raw_size = bytes.size() + 2;
 		if (raw_size > 65536) {
 			assert(false);	// too many bytes
-			return ByteArray();
+			return false;
 		}
-
-		ByteArray out;
-		out.reserve(bytes.size() + 2 + 2);
 		
-		// Calculate checksum
-		const byte leading_byte = is_header ? 0x00 : 0xFF;
-		byte checksum = leading_byte;
-		for (byte b: bytes) {
-			checksum ^= b;
-		}
+		// Make space for the whole block and construct final tape stream in place.
+		const size_t offset = out.size();
+		out.resize(offset + tapeStreamSize(bytes.size(), is_tap_block));
+		byte * p = out.data() + offset;
 		
-		// Construct final tape stream
 		if (is_tap_block) {
-			U16 block_size = raw_size;
-			out.append(MakeRange(block_size));
+			*p++ =  raw_size       & 0xFF;
+			*p++ = (raw_size >> 8) & 0xFF;
 		}
-		out.push_back(leading_byte);
-		out.append(bytes);
-		out.append(checksum);
-
-		return out;
+		const byte leading_byte = is_header ? 0x00 : 0xFF;
+		*p++ = leading_byte;
+		// Copy bytes and calculate checksum at once.
+		p[bytes.size()] = CopyWithChecksum(p, leading_byte, bytes);
+		return true;
 	}
 	
 	// MARK: - Private
 	
+	byte TapArchiveBuilder::checksum(byte leading_byte, const ByteRange & bytes)
+	{
+		return XorChecksum(leading_byte, bytes);
+	}
+	
+	bool TapArchiveBuilder::validate() const
+	{
+		std::vector<FileEntry::ValidationResult> issues;
+		for (auto && file: _files) {
+			if (!file.validate(issues)) {
+				bool critical = false;
+				for (auto ec: issues) {
+					reportError(file, ec);
+					if (ec > FileEntry::ERR) {
+						critical = true;
+					}
+				}
+				if (critical) {
+					// TODO: throw exception...
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+	
 	void TapArchiveBuilder::reportError(const FileEntry & entry, FileEntry::ValidationResult result) const
 	{
 		ErrorInfo ei;